@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <stddef.h>
+
 #define COORD(i, j, n) (i) * (n) + (j)
 
 #define ABS(a) ((a) > 0 ? (a) : -(a))
@@ -26,6 +28,20 @@
 
 #define SQUARE(a) (a) * (a)
 
+// Element (i, j), i >= j, of the lower triangle stored by columns in
+// n (n + 1) / 2 doubles
+#define PACKED(i, j, n) ((size_t)(j) * (2 * (size_t)(n) - (j) - 1) / 2 + (i))
+
+// Element (i, j) of the symmetric matrix stored in full or packed
+#define ELEMENT(matrix, i, j, n, packed) ((packed) ? \
+	(matrix)[PACKED(MAX(i, j), MIN(i, j), n)] : (matrix)[COORD(i, j, n)])
+
 //#define EPS 1e-16
 
-double f(int n, int k, int i, int j);
\ No newline at end of file
+double f(int n, int k, int i, int j);
+
+void synchronize(int threads_amount);
+
+// Indices [start, end) of the thread, cut into contiguous parts
+void thread_range(int start, int end, int thread_id, int threads_amount,
+		int *first, int *last);
\ No newline at end of file
@@ -0,0 +1,405 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "divide.h"
+#include "common.h"
+
+// Steps allowed per root of the secular equation
+#define SECULAR_ITERATIONS_MAX 100
+
+static int compare_poles(const void *a, const void *b) {
+	double x = ((const struct secular_pole*)a)->d;
+	double y = ((const struct secular_pole*)b)->d;
+
+	return (x > y) - (x < y);
+}
+
+// Part [first, end) of the matrix at the given depth of the halving
+static void node_range(int order, int depth, int node, int *first,
+		int *end) {
+	int middle;
+
+	*first = 0;
+	*end = order;
+	for(int bit = depth - 1; bit >= 0; bit--) {
+		middle = *first + (*end - *first) / 2;
+		if((node >> bit) & 1) {
+			*first = middle;
+		} else {
+			*end = middle;
+		}
+	}
+}
+
+static void tear(struct divide_conquer *divide, int first, int end) {
+	int middle = first + (end - first) / 2;
+
+	if(end - first > 1) {
+		divide->diagonal[middle - 1] -= divide->subdiagonal[middle - 1];
+		divide->diagonal[middle] -= divide->subdiagonal[middle - 1];
+	}
+}
+
+// Sorts the poles of the merge of [first, middle) and [middle, end) and
+// deflates them: a pole with negligible z, or one rotated against a close
+// neighbour until its z vanishes, is an eigenvalue already and goes to the
+// end of the part. Returns the number of poles left at the beginning of
+// the part. For negative b the signs of the poles are changed, so rho is
+// always positive
+static int deflate_poles(struct divide_conquer *divide, int first,
+		int middle, int end) {
+	struct secular_pole *poles = divide->poles + first;
+	struct secular_pole current, *previous;
+	double beta = divide->subdiagonal[middle - 1];
+	double sign = beta < 0.0 ? -1.0 : 1.0;
+	double rho = 2.0 * fabs(beta);
+	double scale = 0.0, tolerance, r, cos_phi, sin_phi;
+	int kept = 0, back = end;
+
+	// v has length sqrt(2), it goes to rho
+	for(int i = first; i < middle; i++) {
+		poles[i - first].d = sign * divide->values[i];
+		poles[i - first].z = divide->last[i] / M_SQRT2;
+		poles[i - first].first = divide->first[i];
+		poles[i - first].last = 0.0;
+	}
+	for(int i = middle; i < end; i++) {
+		poles[i - first].d = sign * divide->values[i];
+		poles[i - first].z = divide->first[i] / M_SQRT2;
+		poles[i - first].first = 0.0;
+		poles[i - first].last = divide->last[i];
+	}
+	qsort(poles, end - first, sizeof(struct secular_pole), compare_poles);
+
+	for(int i = 0; i < end - first; i++) {
+		scale = MAX(scale, fabs(poles[i].d));
+	}
+	tolerance = 8.0 * DBL_EPSILON * MAX(scale, rho);
+
+	for(int i = 0; i < end - first; i++) {
+		current = poles[i];
+		if(rho * fabs(current.z) <= tolerance) {
+			back--;
+			divide->values[back] = sign * current.d;
+			divide->first[back] = current.first;
+			divide->last[back] = current.last;
+			continue;
+		}
+
+		if(kept > 0) {
+			previous = poles + kept - 1;
+			r = hypot(previous->z, current.z);
+			cos_phi = current.z / r;
+			sin_phi = previous->z / r;
+
+			// The rotation zeroes z of the previous pole and leaves
+			// (current.d - previous->d) cos sin off the diagonal
+			if(fabs((current.d - previous->d) * cos_phi * sin_phi) <=
+				tolerance) {
+				back--;
+				divide->values[back] = sign * (SQUARE(cos_phi) * previous->d +
+					SQUARE(sin_phi) * current.d);
+				divide->first[back] = cos_phi * previous->first -
+					sin_phi * current.first;
+				divide->last[back] = cos_phi * previous->last -
+					sin_phi * current.last;
+
+				current.d = SQUARE(sin_phi) * previous->d +
+					SQUARE(cos_phi) * current.d;
+				current.z = r;
+				current.first = sin_phi * previous->first +
+					cos_phi * current.first;
+				current.last = sin_phi * previous->last +
+					cos_phi * current.last;
+				kept--;
+			}
+		}
+		poles[kept++] = current;
+	}
+	return kept;
+}
+
+// Root j of the secular equation with kept poles in ascending order. It
+// lies between poles j and j + 1, or above the last pole, and is counted
+// from the nearer pole, so that its distances to the poles are exact.
+// The steps solve a model with these two poles exact and the rest of the
+// sum linear, and fall back to bisection when they leave the bracket.
+// Returns 1 if the root is not found
+static int secular_root(const struct secular_pole *poles, int kept, int j,
+		double rho, double *shift, int *origin) {
+	double lower, upper, tau, value, psi, dpsi, phi, dphi, delta, t;
+	double a, b, c, s, r, disc, eta;
+	int o;
+
+	if(j < kept - 1) {
+		// f grows from the pole j to the pole j + 1, its sign in the
+		// middle tells the nearer one
+		delta = (poles[j + 1].d - poles[j].d) / 2.0;
+		value = 1.0;
+		for(int i = 0; i < kept; i++) {
+			value += rho * SQUARE(poles[i].z) /
+				(poles[i].d - poles[j].d - delta);
+		}
+		if(value >= 0.0) {
+			o = j;
+			lower = 0.0;
+			upper = delta;
+		} else {
+			o = j + 1;
+			lower = -delta;
+			upper = 0.0;
+		}
+	} else {
+		o = j;
+		lower = 0.0;
+		upper = 0.0;
+		for(int i = 0; i < kept; i++) {
+			upper += SQUARE(poles[i].z);
+		}
+		upper *= rho;
+	}
+
+	tau = (lower + upper) / 2.0;
+	for(int iteration = 0; iteration < SECULAR_ITERATIONS_MAX;
+		iteration++) {
+		psi = dpsi = phi = dphi = 0.0;
+		for(int i = 0; i <= j; i++) {
+			t = poles[i].z / (poles[i].d - poles[o].d - tau);
+			psi += poles[i].z * t;
+			dpsi += SQUARE(t);
+		}
+		for(int i = j + 1; i < kept; i++) {
+			t = poles[i].z / (poles[i].d - poles[o].d - tau);
+			phi += poles[i].z * t;
+			dphi += SQUARE(t);
+		}
+		value = 1.0 + rho * (psi + phi);
+		if(value < 0.0) {
+			lower = tau;
+		} else {
+			upper = tau;
+		}
+		if(fabs(value) <= kept * DBL_EPSILON * (1.0 + rho * (phi - psi)) ||
+			upper - lower <= 2.0 * DBL_EPSILON *
+			MAX(fabs(lower), fabs(upper))) {
+			*shift = tau;
+			*origin = o;
+			return 0;
+		}
+
+		// c + s / (a - eta) + r / (b - eta) = 0 with a and b the distances
+		// to the poles j and j + 1
+		a = poles[j].d - poles[o].d - tau;
+		s = rho * dpsi * SQUARE(a);
+		c = 1.0 + rho * (psi - dpsi * a);
+		if(j < kept - 1) {
+			b = poles[j + 1].d - poles[o].d - tau;
+			r = rho * dphi * SQUARE(b);
+			c += rho * (phi - dphi * b);
+
+			// c eta^2 - t eta + a b value = 0, the root nearer to 0
+			t = c * (a + b) + s + r;
+			disc = SQUARE(t) - 4.0 * c * a * b * value;
+			eta = disc < 0.0 ? NAN : 2.0 * a * b * value /
+				(t + copysign(sqrt(disc), t));
+		} else {
+			eta = c > 0.0 ? a + s / c : NAN;
+		}
+
+		tau += eta;
+		if(!(tau > lower && tau < upper)) {
+			tau = (lower + upper) / 2.0;
+		}
+	}
+	return 1;
+}
+
+// Distance from pole i to root j
+static inline double root_distance(const struct divide_conquer *divide,
+		const struct secular_pole *poles, int first, int i, int j) {
+	return poles[i].d - poles[divide->origins[first + j]].d -
+		divide->shifts[first + j];
+}
+
+// Merges the solved parts [first, middle) and [middle, end), all threads
+// given call it together
+static void merge(struct divide_conquer *divide, int first, int middle,
+		int end, int thread_id, int threads_amount) {
+	struct secular_pole *poles = divide->poles + first;
+	double beta = divide->subdiagonal[middle - 1];
+	double sign = beta < 0.0 ? -1.0 : 1.0;
+	double rho = 2.0 * fabs(beta);
+	double product, norm, u, first_row, last_row;
+	int kept, start, stop, o;
+
+	if(thread_id == 0) {
+		divide->kept[first] = deflate_poles(divide, first, middle, end);
+	}
+	synchronize(threads_amount);
+	kept = divide->kept[first];
+	thread_range(0, kept, thread_id, threads_amount, &start, &stop);
+
+	for(int j = start; j < stop; j++) {
+		if(secular_root(poles, kept, j, rho, divide->shifts + first + j,
+			divide->origins + first + j)) {
+			atomic_store(&divide->failed, 1);
+			divide->shifts[first + j] = 0.0;
+			divide->origins[first + j] = j;
+		}
+	}
+	synchronize(threads_amount);
+
+	// z again from the roots as the exact one of the computed roots, the
+	// eigenvectors stay orthogonal then
+	for(int i = start; i < stop; i++) {
+		product = -root_distance(divide, poles, first, i, kept - 1) / rho;
+		for(int j = 0; j < i; j++) {
+			product *= root_distance(divide, poles, first, i, j) /
+				(poles[i].d - poles[j].d);
+		}
+		for(int j = i; j < kept - 1; j++) {
+			product *= root_distance(divide, poles, first, i, j) /
+				(poles[i].d - poles[j + 1].d);
+		}
+		divide->weights[first + i] = copysign(sqrt(fabs(product)),
+			poles[i].z);
+	}
+	synchronize(threads_amount);
+
+	// Eigenvector j of the merge is (D - x I)^-1 z, only its first and
+	// last rows are kept. The pole the root is counted from is the nearest
+	// one, so the vector times the shift does not overflow
+	for(int j = start; j < stop; j++) {
+		norm = first_row = last_row = 0.0;
+		for(int i = 0; i < kept; i++) {
+			u = divide->weights[first + i] * divide->shifts[first + j] /
+				root_distance(divide, poles, first, i, j);
+			norm += SQUARE(u);
+			first_row += poles[i].first * u;
+			last_row += poles[i].last * u;
+		}
+		norm = sqrt(norm);
+		o = divide->origins[first + j];
+		divide->values[first + j] = sign * (poles[o].d +
+			divide->shifts[first + j]);
+		divide->first[first + j] = first_row / norm;
+		divide->last[first + j] = last_row / norm;
+	}
+	synchronize(threads_amount);
+}
+
+static void solve_part(struct divide_conquer *divide, int first, int end) {
+	int middle = first + (end - first) / 2;
+
+	if(end - first == 1) {
+		divide->values[first] = divide->diagonal[first];
+		divide->first[first] = 1.0;
+		divide->last[first] = 1.0;
+	}
+	if(end - first < 2) {
+		return;
+	}
+
+	tear(divide, first, end);
+	solve_part(divide, first, middle);
+	solve_part(divide, middle, end);
+	merge(divide, first, middle, end, 0, 1);
+}
+
+int divide_init(struct divide_conquer *divide, double *diagonal,
+		double *subdiagonal, double *values, int order, int threads_amount) {
+	divide->diagonal = diagonal;
+	divide->subdiagonal = subdiagonal;
+	divide->values = values;
+	divide->order = order;
+	atomic_init(&divide->failed, 0);
+
+	// Every thread gets at least one part of the bottom levels
+	divide->levels = 0;
+	while((1 << divide->levels) < threads_amount) {
+		divide->levels++;
+	}
+
+	divide->first = (double*)malloc(4 * (size_t)order * sizeof(double));
+	if(!divide->first) {
+		goto final;
+	}
+	divide->last = divide->first + order;
+	divide->shifts = divide->last + order;
+	divide->weights = divide->shifts + order;
+	divide->poles = (struct secular_pole*)malloc(order *
+			sizeof(struct secular_pole));
+	if(!divide->poles) {
+		goto free_first;
+	}
+	divide->origins = (int*)malloc(2 * (size_t)order * sizeof(int));
+	if(!divide->origins) {
+		goto free_poles;
+	}
+	divide->kept = divide->origins + order;
+	return 0;
+
+	free_poles:
+	free(divide->poles);
+	free_first:
+	free(divide->first);
+	final:
+	return 2;
+}
+
+void divide_free(struct divide_conquer *divide) {
+	free(divide->origins);
+	free(divide->poles);
+	free(divide->first);
+}
+
+// The parts of the bottom levels are solved by one thread each, the merges
+// of the top levels are shared by all threads
+void divide_eigenvalues(struct divide_conquer *divide, int thread_id,
+		int threads_amount) {
+	int first, end;
+
+	if(thread_id == 0) {
+		for(int depth = 0; depth < divide->levels; depth++) {
+			for(int node = 0; node < 1 << depth; node++) {
+				node_range(divide->order, depth, node, &first, &end);
+				tear(divide, first, end);
+			}
+		}
+	}
+	synchronize(threads_amount);
+
+	for(int node = thread_id; node < 1 << divide->levels;
+		node += threads_amount) {
+		node_range(divide->order, divide->levels, node, &first, &end);
+		solve_part(divide, first, end);
+	}
+	synchronize(threads_amount);
+
+	for(int depth = divide->levels - 1; depth >= 0; depth--) {
+		for(int node = 0; node < 1 << depth; node++) {
+			node_range(divide->order, depth, node, &first, &end);
+			if(end - first > 1) {
+				merge(divide, first, first + (end - first) / 2, end,
+					thread_id, threads_amount);
+			}
+		}
+	}
+}
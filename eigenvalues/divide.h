@@ -0,0 +1,64 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+
+// Cuppen's divide and conquer for the eigenvalues of the tridiagonal
+// matrix. Taking b = subdiagonal[m - 1] off both diagonal elements m - 1
+// and m tears the matrix into two halves plus the rank one b v v^T, with
+// v = e(m - 1) + e(m). The halves are solved recursively, and the
+// eigenvalues of the whole are the roots of the secular equation
+//   1 + rho sum z[i]^2 / (d[i] - x) = 0
+// with the eigenvalues d of the halves and z made of the last row of the
+// eigenvectors of the upper half and the first row of those of the lower
+// one. Only these two rows of the eigenvectors are carried up, so a merge
+// of order n costs O(n^2) and no n x n matrix is kept
+struct secular_pole {
+	double d;
+	double z;
+	double first; // first row of the eigenvectors
+	double last; // last row of the eigenvectors
+};
+
+struct divide_conquer {
+	double *diagonal;
+	double *subdiagonal;
+	double *values;
+	int order;
+	int levels; // the top levels are merged by all threads together
+	double *first; // first row of the eigenvectors of every solved part
+	double *last;
+	struct secular_pole *poles;
+	double *shifts; // roots from their nearest pole
+	int *origins; // poles the roots are counted from
+	double *weights; // z recomputed from the roots
+	int *kept; // poles left after deflation, by first index of the part
+	atomic_int failed;
+};
+
+// Prepares the solution of the tridiagonal matrix of the given arrays by
+// threads_amount threads. Returns 2 if memory cannot be allocated
+int divide_init(struct divide_conquer *divide, double *diagonal,
+		double *subdiagonal, double *values, int order, int threads_amount);
+
+void divide_free(struct divide_conquer *divide);
+
+// Called by every thread, the diagonal is destroyed. failed is set if
+// some secular equation is not solved
+void divide_eigenvalues(struct divide_conquer *divide, int thread_id,
+		int threads_amount);
@@ -14,20 +14,117 @@
  * limitations under the License.
  */
 
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "common.h"
+#include "divide.h"
+#include "kernels.h"
 #include "matrixio.h"
 #include "matrixlib.h"
+#include "structured.h"
+#include "tridiagonal.h"
+
+struct thread_args {
+	int thread_id;
+	int threads_amount;
+	double *matrix;
+	double *work;
+	int order;
+	int reduction;
+	int packed;
+	int solver;
+	double *tridiagonal;
+	struct tridiagonal_queue *queue;
+	struct divide_conquer *divide;
+};
+
+int structured(int n, int m, int k, int structure, double *parameters);
+
+void print_residuals(double trace, double norm, const double *eigenvalues,
+		int n);
+
+void print_iterations(const int *iterations, int n);
+
+void *thread_execute(void *p_args);
+
+int eigenvalues_threaded(struct thread_args *job, int threads_amount);
 
 int main(int argc, char **argv) {
-	int n, m, k;
-	double *matrix, *eigenvalues, eps;
-	clock_t begin, end;
+	int n, m, k, option, dense = 0, structure = STRUCTURE_NONE;
+	int threads_amount = 1, reduction = REDUCTION_HOUSEHOLDER, packed = 0;
+	int solver = SOLVER_QR;
+	double *matrix, *eigenvalues, *tridiagonal, eps, parameters[3];
+	double norm, trace, frobenius;
+	int *iterations;
+	struct timespec begin, end;
+	struct tridiagonal_queue queue;
+	struct divide_conquer divide;
+	struct thread_args job;
 	int exit_code = 0;
 	char *filename = NULL;
 
+	// Usage: a.out [-d] [-l] [-p threads_amount] [-r householder|givens]
+	// [-t qr|divide] n m eps k [filename]
+	// -d turns off the closed forms for the formulas and for the loaded
+	// tridiagonal Toeplitz, arrowhead and reversed min(i, j) matrices
+	// -p reduces the matrix to tridiagonal form with threads_amount threads,
+	// then they take the independent blocks of the tridiagonal matrix
+	// -l keeps only the lower triangle, n (n + 1) / 2 doubles, the file may
+	// then hold either all rows or the rows of the lower triangle. The
+	// Givens reduction needs the full matrix
+	// -r selects the reduction, by default blocked Householder reflectors
+	// on the upper triangle
+	// -t selects the solver of the tridiagonal matrix, by default QR steps,
+	// divide is Cuppen's divide and conquer
+	while((option = getopt(argc, argv, "dlp:r:t:")) != -1) {
+		switch(option) {
+			case 'd':
+				dense = 1;
+				break;
+			case 'l':
+				packed = 1;
+				break;
+			case 'r':
+				if(!strcmp(optarg, "householder")) {
+					reduction = REDUCTION_HOUSEHOLDER;
+				} else if(!strcmp(optarg, "givens")) {
+					reduction = REDUCTION_GIVENS;
+				} else {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 't':
+				if(!strcmp(optarg, "qr")) {
+					solver = SOLVER_QR;
+				} else if(!strcmp(optarg, "divide")) {
+					solver = SOLVER_DIVIDE;
+				} else {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'p':
+				if(sscanf(optarg, "%d", &threads_amount) != 1 ||
+					threads_amount < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			default:
+				exit_code = 1;
+				goto final;
+		}
+	}
+	argc -= optind - 1;
+	argv += optind - 1;
+
 	if((argc < 5) || (argc > 6)) {
 		exit_code = 1;
 		goto final;
@@ -48,7 +145,8 @@ int main(int argc, char **argv) {
 		exit_code = 1;
 		goto final;
 	}
-	if(k < 0 || k > 4 || n < 1 || m < 1 || eps < 0.0) {
+	if(k < 0 || k > 4 || n < 1 || m < 1 || eps < 0.0 ||
+		(packed && reduction == REDUCTION_GIVENS)) {
 		exit_code = 1;
 		goto final;
 	}
@@ -60,7 +158,19 @@ int main(int argc, char **argv) {
 		filename = argv[5];
 	}
 
-	matrix = (double*)malloc(n * n * sizeof(double));
+	init_kernels();
+
+	// The eigenvalues are known without the n x n matrix
+	if(!dense) {
+		structure = formula_structure(n, k, parameters);
+	}
+	if(structure != STRUCTURE_NONE) {
+		exit_code = structured(n, m, k, structure, parameters);
+		goto final;
+	}
+
+	matrix = (double*)malloc((packed ? PACKED(n, n, n) : (size_t)n * n) *
+			sizeof(double));
 	if(!matrix) {
 		fprintf(stderr, "ERROR: not enough memory!");
 		exit_code = 2;
@@ -72,38 +182,274 @@ int main(int argc, char **argv) {
 		exit_code = 3;
 		goto free_matrix;
 	}
+	tridiagonal = (double*)malloc(2 * n * sizeof(double));
+	if(!tridiagonal) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_eigenvalues;
+	}
+	iterations = (int*)malloc(n * sizeof(int));
+	if(!iterations) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_tridiagonal;
+	}
 
-	if(read_matrix(matrix, n, k, filename)) {
+	if(read_matrix(matrix, n, k, filename, packed)) {
 		exit_code = 4;
-		goto free_eigenvalues;
+		goto free_iterations;
 	}
 
 	printf("Original matrix:\n");
-	print_matrix(matrix, n, n, m);
+	if(packed) {
+		print_packed(matrix, n, m);
+	} else {
+		print_matrix(matrix, n, n, m);
+	}
 	printf("\n");
 
-	begin = clock();
-	get_eigenvalues(matrix, eigenvalues, n, eps);
-	end = clock();
+	// The reduction destroys the matrix
+	matrix_norms(matrix, n, packed, &trace, &frobenius);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if(!dense) {
+		structure = matrix_structure(matrix, n, packed, parameters);
+	}
+	if(structure != STRUCTURE_NONE) {
+		structured_eigenvalues(structure, parameters, eigenvalues, n);
+	} else if((reduction == REDUCTION_HOUSEHOLDER || threads_amount > 1 ||
+		solver == SOLVER_DIVIDE) && (n > 2 || packed)) {
+		norm = infinity_norm(matrix, n, packed);
+		if(solver == SOLVER_QR ? tridiagonal_init(&queue, tridiagonal,
+			tridiagonal + n, eigenvalues, iterations, n, eps * norm) :
+			divide_init(&divide, tridiagonal, tridiagonal + n, eigenvalues, n,
+			threads_amount)) {
+			fprintf(stderr, "ERROR: not enough memory!");
+			exit_code = 2;
+			goto free_iterations;
+		}
+		job.matrix = matrix;
+		job.order = n;
+		job.packed = packed;
+		job.reduction = reduction;
+		job.solver = solver;
+		job.tridiagonal = tridiagonal;
+		job.queue = &queue;
+		job.divide = &divide;
+		exit_code = eigenvalues_threaded(&job, threads_amount);
+		if(solver == SOLVER_QR) {
+			if(!exit_code && queue.failed) {
+				exit_code = 6;
+			}
+			tridiagonal_free(&queue);
+		} else {
+			if(!exit_code && atomic_load(&divide.failed)) {
+				exit_code = 6;
+			}
+			divide_free(&divide);
+		}
+		if(exit_code == 2) {
+			goto free_iterations;
+		}
+	} else {
+		// QR steps, also for -t divide at the orders 1 and 2
+		solver = SOLVER_QR;
+		switch(get_eigenvalues(matrix, eigenvalues, iterations, n, eps)) {
+			case 0:
+				break;
+			case 2:
+				fprintf(stderr, "ERROR: not enough memory!");
+				exit_code = 2;
+				goto free_iterations;
+			default:
+				exit_code = 6;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if(exit_code) {
+		fprintf(stderr, "ERROR: %s do not converge\n", solver == SOLVER_QR ?
+			"QR steps" : "secular equations");
+		goto free_iterations;
+	}
 
 	printf("Eigenvalues:\n");
 	print_matrix(eigenvalues, 1, n, n);
+	if(structure == STRUCTURE_NONE && solver == SOLVER_QR) {
+		print_iterations(iterations, n);
+	}
 	printf("\n");
 
-	if(read_matrix(matrix, n, k, filename)){
-		exit_code = 4;
-		goto free_eigenvalues;
+	print_residuals(trace, frobenius, eigenvalues, n);
+	printf("Time used to compute: %.2lf seconds\n",
+		(double)(end.tv_sec - begin.tv_sec) +
+		(double)(end.tv_nsec - begin.tv_nsec) / 1e9);
+
+	free_iterations:
+	free(iterations);
+	free_tridiagonal:
+	free(tridiagonal);
+	free_eigenvalues:
+	free(eigenvalues);
+	free_matrix:
+	free(matrix);
+	final:
+	return exit_code;
+}
+
+int structured(int n, int m, int k, int structure, double *parameters) {
+	double *eigenvalues, trace, norm;
+	clock_t begin, end;
+	int exit_code = 0;
+
+	eigenvalues = (double*)malloc(n * sizeof(double));
+	if(!eigenvalues) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto final;
 	}
 
-	printf("Residual 1: %e\n", residual1(matrix, eigenvalues, n));
-	printf("Residual 2: %e\n", residual2(matrix, eigenvalues, n));
+	printf("Original matrix:\n");
+	print_formula(n, k, m);
+	printf("\n");
+
+	begin = clock();
+	structured_eigenvalues(structure, parameters, eigenvalues, n);
+	end = clock();
+
+	printf("Eigenvalues:\n");
+	print_matrix(eigenvalues, 1, n, n);
+	printf("\n");
+
+	structured_norms(structure, parameters, n, &trace, &norm);
+	print_residuals(trace, norm, eigenvalues, n);
 	printf("Time used to compute: %.2lf seconds\n", (double)(end - begin)
 		/ CLOCKS_PER_SEC);
 
-	free_eigenvalues:
 	free(eigenvalues);
-	free_matrix:
-	free(matrix);
 	final:
 	return exit_code;
 }
+
+// Residual 1 compares the trace with the sum of the eigenvalues, residual 2
+// the Frobenius norm with the length of the vector of them
+void print_residuals(double trace, double norm, const double *eigenvalues,
+		int n) {
+	double sum = 0.0, square = 0.0;
+
+	for(int i = 0; i < n; i++) {
+		sum += eigenvalues[i];
+		square += SQUARE(eigenvalues[i]);
+	}
+
+	printf("Residual 1: %e\n", fabs(trace - sum));
+	printf("Residual 2: %e\n", fabs(norm - sqrt(square)));
+}
+
+// QR steps under every eigenvalue and their total
+void print_iterations(const int *iterations, int n) {
+	long int total = 0;
+
+	for(int i = 0; i < n; i++) {
+		printf(" %10d", iterations[i]);
+		total += iterations[i];
+	}
+	printf("\n");
+	printf("QR steps: %ld, %.2lf per eigenvalue\n", total, (double)total / n);
+}
+
+// Returns 2 if memory cannot be allocated, exits with 5 if threads cannot
+// be created
+int eigenvalues_threaded(struct thread_args *job, int threads_amount) {
+	int order = job->order;
+	struct thread_args *args;
+	pthread_t *threads;
+	double *work;
+	int created, exit_code = 0;
+
+	args = (struct thread_args*)malloc(threads_amount *
+			sizeof(struct thread_args));
+	if(!args) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 2;
+		goto final;
+	}
+	threads = (pthread_t*)malloc(threads_amount * sizeof(pthread_t));
+	if(!threads) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 2;
+		goto free_args;
+	}
+	if(job->reduction == REDUCTION_HOUSEHOLDER) {
+		work = (double*)malloc(householder_work_size(order, threads_amount) *
+				sizeof(double));
+	} else {
+		work = (double*)malloc(2 * (size_t)order * threads_amount *
+				sizeof(double));
+	}
+	if(!work) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 2;
+		goto free_threads;
+	}
+
+	// Thread 0 is the main one
+	args[0] = *job;
+	args[0].thread_id = 0;
+	args[0].threads_amount = threads_amount;
+	args[0].work = work;
+	for(created = 1; created < threads_amount; created++) {
+		args[created] = args[0];
+		args[created].thread_id = created;
+		if(pthread_create(threads + created, NULL, thread_execute,
+			args + created)) {
+			break;
+		}
+	}
+	if(created < threads_amount) {
+		// The created threads would wait for the others at the first
+		// barrier forever
+		fprintf(stderr, "ERROR: Cannot create threads!\n");
+		exit(5);
+	}
+	thread_execute(args);
+	for(int i = 1; i < threads_amount; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	free(work);
+	free_threads:
+	free(threads);
+	free_args:
+	free(args);
+	final:
+	return exit_code;
+}
+
+void *thread_execute(void *p_args) {
+	struct thread_args *args = (struct thread_args*)p_args;
+
+	if(args->reduction == REDUCTION_HOUSEHOLDER) {
+		reduce_householder(args->matrix, args->order, args->packed,
+			args->work, args->thread_id, args->threads_amount);
+	} else {
+		reduce_tridiagonal(args->matrix, args->order, args->work,
+			args->thread_id, args->threads_amount);
+	}
+
+	// Both reductions end at a barrier
+	if(args->thread_id == 0) {
+		tridiagonal_part(args->matrix, args->order, args->packed,
+			args->tridiagonal, args->tridiagonal + args->order);
+		if(args->solver == SOLVER_QR) {
+			tridiagonal_split(args->queue);
+		}
+	}
+	synchronize(args->threads_amount);
+	if(args->solver == SOLVER_QR) {
+		tridiagonal_solve(args->queue);
+	} else {
+		divide_eigenvalues(args->divide, args->thread_id,
+			args->threads_amount);
+	}
+	return NULL;
+}
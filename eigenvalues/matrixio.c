@@ -15,12 +15,62 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "common.h"
 #include "matrixio.h"
 
+static int read_element(FILE *fin, double *element) {
+	int result = fscanf(fin, "%lf", element);
+
+	if(result != 1) {
+		if(result == EOF) {
+			fprintf(stderr, "ERROR: unexcepted EOF while reading matrix\n");
+		} else {
+			fprintf(stderr, "ERROR: got invalid data while reading matrix\n");
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// A triangle file holds the rows of the lower triangle, the upper triangle
+// of a full file is skipped
+static int read_packed(FILE *fin, double *matrix, int order) {
+	double skipped;
+	int result;
+
+	for(int i = 0; i < order; i++) {
+		for(int j = 0; j <= i; j++) {
+			if(read_element(fin, matrix + PACKED(i, j, order))) {
+				return 1;
+			}
+		}
+	}
+	result = fscanf(fin, "%lf", &skipped);
+	if(result == EOF) {
+		return 0;
+	}
+	if(result != 1) {
+		fprintf(stderr, "ERROR: got invalid data while reading matrix\n");
+		return 1;
+	}
+
+	// The file is full, read it again by rows
+	rewind(fin);
+	for(int i = 0; i < order; i++) {
+		for(int j = 0; j < order; j++) {
+			if(read_element(fin, j <= i ? matrix + PACKED(i, j, order) :
+				&skipped)) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
 int read_matrix(double *matrix, int order, int formula_number,
-	char *filename) {
+	char *filename, int packed) {
 	if(filename) {
 		FILE *fin = fopen(filename, "r");
 		int result = 0;
@@ -28,23 +78,22 @@ int read_matrix(double *matrix, int order, int formula_number,
 			perror("ERROR: failed to open file");
 			return 1;
 		}
-		for(int i = 0; i < order; i++) {
-			for(int j = 0; j < order; j++) {
-				result = fscanf(fin, "%lf", matrix + COORD(i, j, order));
-				if(result != 1) {
-					if(result == EOF) {
-						fprintf(stderr,
-							"ERROR: unexcepted EOF while reading matrix\n");
-					} else {
-						fprintf(stderr,
-							"ERROR: got invalid data while reading matrix\n");
-					}
-					fclose(fin);
-					return 1;
-				}
+		if(packed) {
+			result = read_packed(fin, matrix, order);
+		} else {
+			for(int i = 0; i < order * order && !result; i++) {
+				result = read_element(fin, matrix + i);
 			}
 		}
 		fclose(fin);
+		return result;
+	} else if(packed) {
+		for(int j = 0; j < order; j++) {
+			for(int i = j; i < order; i++) {
+				matrix[PACKED(i, j, order)] = f(order, formula_number, i + 1,
+					j + 1);
+			}
+		}
 	} else {
 		for(int i = 0; i < order; i++) {
 			for(int j = 0; j < order; j++) {
@@ -65,4 +114,30 @@ void print_matrix(double *matrix, int height, int width, int max_cols_rows) {
 		}
 		printf("\n");
 	}
-}
\ No newline at end of file
+}
+
+void print_formula(int order, int formula_number, int max_cols_rows) {
+	int size = MIN(order, max_cols_rows);
+	double *block = (double*)malloc((size_t)size * size * sizeof(double));
+
+	if(!block) {
+		return;
+	}
+	for(int i = 0; i < size; i++) {
+		for(int j = 0; j < size; j++) {
+			block[COORD(i, j, size)] = f(order, formula_number, i + 1, j + 1);
+		}
+	}
+	print_matrix(block, size, size, size);
+	free(block);
+}
+
+void print_packed(double *matrix, int order, int max_cols_rows) {
+	int size = MIN(order, max_cols_rows);
+	for(int i = 0; i < size; i++) {
+		for(int j = 0; j < size; j++) {
+			printf(" %10.3e", ELEMENT(matrix, i, j, order, 1));
+		}
+		printf("\n");
+	}
+}
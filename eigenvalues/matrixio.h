@@ -16,7 +16,15 @@
 
 #pragma once
 
+// With packed the lower triangle is stored by columns, a file may hold
+// either all rows or only the rows of the lower triangle
 int read_matrix(double *matrix, int order, int formula_number,
-	char *filename);
+	char *filename, int packed);
 
-void print_matrix(double *matrix, int height, int width, int max_cols_rows);
\ No newline at end of file
+void print_matrix(double *matrix, int height, int width, int max_cols_rows);
+
+// Prints the upper left corner of the formula matrix without forming it
+void print_formula(int order, int formula_number, int max_cols_rows);
+
+// Prints the upper left corner of the packed matrix
+void print_packed(double *matrix, int order, int max_cols_rows);
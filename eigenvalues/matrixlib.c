@@ -17,22 +17,381 @@
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "matrixlib.h"
 #include "matrixio.h"
 #include "common.h"
+#include "kernels.h"
+#include "tridiagonal.h"
 
-int get_eigenvalues(double *matrix, double *values, int order, double eps) {
-	double temp1, temp2, temp3, temp4, temp5;
-	double cos_phi = 0.0, sin_phi = 0.0;
-	double cos_phi1 = 0.0, sin_phi1 = 0.0;
-	double norm = infinity_norm(matrix, order);
+// Largest order with the specialized method
+#define FIXED_ORDER_MAX 16
 
-	double *main_diag = matrix;
-	double *lower_diag = matrix + order;
+// Rows rotated together from right by reduce_tridiagonal()
+#define ROTATED_ROWS 4
+
+static inline int eigenvalues_body(double *matrix, double *values,
+		int *iterations, int order, double eps)
+		__attribute__((always_inline));
+
+static inline void relocate_tridiagonal(double *matrix, int order)
+		__attribute__((always_inline));
+
+// get_eigenvalues() specialized at compile time: the body is inlined with
+// the constant order, so the loops get constant bounds and the index
+// arithmetic is folded
+#define FIXED_EIGENVALUES(n) \
+static int get_eigenvalues_##n(double *matrix, double *values, \
+		int *iterations, double eps) { \
+	return eigenvalues_body(matrix, values, iterations, n, eps); \
+}
+
+FIXED_EIGENVALUES(2)
+FIXED_EIGENVALUES(3)
+FIXED_EIGENVALUES(4)
+FIXED_EIGENVALUES(8)
+FIXED_EIGENVALUES(16)
+
+static int (*const fixed_eigenvalues[FIXED_ORDER_MAX + 1])(double *matrix,
+		double *values, int *iterations, double eps) = {
+	[2] = get_eigenvalues_2,
+	[3] = get_eigenvalues_3,
+	[4] = get_eigenvalues_4,
+	[8] = get_eigenvalues_8,
+	[16] = get_eigenvalues_16
+};
+
+int get_eigenvalues(double *matrix, double *values, int *iterations,
+		int order, double eps) {
+	double *rotations, norm;
+
+	// relocate_tridiagonal() needs the subdiagonal, a 1 x 1 matrix has none
+	if(order == 1) {
+		values[0] = matrix[0];
+		iterations[0] = 0;
+		return 0;
+	}
+	if(order <= FIXED_ORDER_MAX && fixed_eigenvalues[order]) {
+		return fixed_eigenvalues[order](matrix, values, iterations, eps);
+	}
+	if(order <= FIXED_ORDER_MAX) {
+		return eigenvalues_body(matrix, values, iterations, order, eps);
+	}
+
+	// Larger orders are reduced by batches of rotations even on one thread,
+	// the row updates of a batch run at once
+	rotations = (double*)malloc(2 * (size_t)order * sizeof(double));
+	if(!rotations) {
+		return 2;
+	}
+	norm = infinity_norm(matrix, order, 0);
+	reduce_tridiagonal(matrix, order, rotations, 0, 1);
+	free(rotations);
+	relocate_tridiagonal(matrix, order);
+	return tridiagonal_eigenvalues(matrix, matrix + order, values, iterations,
+		order, eps, norm);
+}
+
+// Row r of the upper triangle from the diagonal on, the lower triangle
+// stored by columns holds the same elements
+static inline double *upper_row(double *matrix, int order, int packed,
+		int r) {
+	return packed ? matrix + PACKED(r, r, order) :
+		matrix + COORD(r, r, order);
+}
+
+void tridiagonal_part(double *matrix, int order, int packed,
+		double *diagonal, double *subdiagonal) {
+	double *row;
+
+	for(int i = 0; i < order; i++) {
+		row = upper_row(matrix, order, packed, i);
+		diagonal[i] = row[0];
+		subdiagonal[i] = i < order - 1 ? row[1] : 0.0;
+	}
+}
+
+// The rotations T(i + 1, j) of step i only depend on row i, so the whole
+// batch is built first and then applied by all threads at once: from the
+// left every column is rotated on its own, from the right every row
+void reduce_tridiagonal(double *matrix, int order, double *rotations,
+		int thread_id, int threads_amount) {
+	double temp1, temp2, cos_phi, sin_phi, pivot[ROTATED_ROWS];
+	double *cosines = rotations + 2 * (size_t)order * thread_id;
+	double *sines = cosines + order;
+	double *row;
+	int first, last, rows;
+
+	for(int i = 0; i < order - 2; i++) {
+		// Every thread builds the batch on its own, row i is not written
+		// until all of them are past the first barrier
+		temp1 = matrix[COORD(i + 1, i, order)];
+		for(int j = i + 2; j < order; j++) {
+			if(fabs(matrix[COORD(i, j, order)]) < 1e-16) {
+				cosines[j] = 1.0;
+				sines[j] = 0.0;
+				continue;
+			}
+			temp2 = sqrt(SQUARE(temp1) + SQUARE(matrix[COORD(i, j, order)]));
+			cosines[j] = temp1 / temp2;
+			sines[j] = -matrix[COORD(i, j, order)] / temp2;
+			temp1 = temp2;
+		}
+
+		// Multiply matrix by the batch from left, rows i + 1 and j of the
+		// columns of the thread
+		thread_range(i + 1, order, thread_id, threads_amount, &first, &last);
+		for(int j = i + 2; j < order; j++) {
+			if(sines[j] != 0.0 && last > first) {
+				vector_rotate(cosines[j], sines[j], matrix + COORD(i + 1,
+					first, order), matrix + COORD(j, first, order),
+					last - first);
+			}
+		}
+		synchronize(threads_amount);
+
+		// Multiply matrix by the transposed batch from right, columns i + 1
+		// and j of the rows
+		// of the thread, four rows at once so that their chains of updates
+		// of column i + 1 overlap
+		for(int r = first; r < last; r += ROTATED_ROWS) {
+			rows = MIN(ROTATED_ROWS, last - r);
+			for(int l = 0; l < rows; l++) {
+				pivot[l] = matrix[COORD(r + l, i + 1, order)];
+			}
+			for(int j = i + 2; j < order; j++) {
+				cos_phi = cosines[j];
+				sin_phi = sines[j];
+				if(sin_phi == 0.0) {
+					continue;
+				}
+				for(int l = 0; l < rows; l++) {
+					row = matrix + COORD(r + l, j, order);
+					temp2 = pivot[l];
+					pivot[l] = cos_phi * temp2 - sin_phi * *row;
+					*row = sin_phi * temp2 + cos_phi * *row;
+				}
+			}
+			for(int l = 0; l < rows; l++) {
+				matrix[COORD(r + l, i + 1, order)] = pivot[l];
+			}
+		}
+
+		// We know what happens with i-th column and i-th row
+		if(thread_id == 0) {
+			matrix[COORD(i, i + 1, order)] = temp1;
+			matrix[COORD(i + 1, i, order)] = temp1;
+			for(int j = i + 2; j < order; j++) {
+				matrix[COORD(i, j, order)] = 0.0;
+				matrix[COORD(j, i, order)] = 0.0;
+			}
+		}
+		synchronize(threads_amount);
+	}
+}
+
+size_t householder_work_size(int order, int threads_amount) {
+	return (size_t)HOUSEHOLDER_BLOCK * 2 * (3 * (size_t)order + GEMM_MR +
+		GEMM_NR) + (size_t)threads_amount * order;
+}
+
+// Householder reflector H = I - tau v v^T with H x = (beta, 0, ..., 0)^T,
+// v[0] = 1. x becomes H x
+static void make_reflector(double *x, int length, double *v, double *tau) {
+	double alpha = x[0], beta, scale;
+	double sigma = vector_dot(x + 1, x + 1, length - 1);
+
+	v[0] = 1.0;
+	if(sigma == 0.0) {
+		memset(v + 1, 0, (length - 1) * sizeof(double));
+		*tau = 0.0;
+		return;
+	}
+
+	beta = sqrt(SQUARE(alpha) + sigma);
+	if(alpha > 0.0) {
+		beta = -beta;
+	}
+	scale = 1.0 / (alpha - beta);
+	for(int k = 1; k < length; k++) {
+		v[k] = x[k] * scale;
+	}
+	*tau = (beta - alpha) / beta;
+
+	x[0] = beta;
+	memset(x + 1, 0, (length - 1) * sizeof(double));
+}
+
+// A -= V W^T + W V^T on the upper triangle of rows and columns [start,
+// order) by the matrix multiplication kernel: the tile of kernel columns
+// r0.. and kernel rows c0.. is matrix[COORD(r0, c0, order)] with the leading
+// dimension order, A packs -[W V] by columns, B packs [V W] by rows. In full
+// storage tiles crossing the diagonal also write below it, that part is
+// never read. Packed rows have no common leading dimension, so every tile
+// is computed aside and only its upper part is added
+static void update_trailing(double *matrix, int order, int packed,
+		int start, int width, const double *vs, const double *ws,
+		double *packed_a, double *packed_b, int thread_id,
+		int threads_amount) {
+	double edge[GEMM_MR * GEMM_NR];
+	double *tile, *row;
+	int depth = 2 * width, length = order - start;
+	int column_panels = (length + GEMM_MR - 1) / GEMM_MR;
+	int row_panels = (length + GEMM_NR - 1) / GEMM_NR;
+	int r0, c0;
+
+	for(int q = thread_id; q < column_panels; q += threads_amount) {
+		tile = packed_a + (size_t)q * GEMM_MR * depth;
+		for(int k = 0; k < depth; k++) {
+			for(int i = 0; i < GEMM_MR; i++) {
+				c0 = start + q * GEMM_MR + i;
+				tile[k * GEMM_MR + i] = c0 >= order ? 0.0 : k < width ?
+					-ws[COORD(k, c0, order)] :
+					-vs[COORD(k - width, c0, order)];
+			}
+		}
+	}
+	for(int s = thread_id; s < row_panels; s += threads_amount) {
+		tile = packed_b + (size_t)s * GEMM_NR * depth;
+		for(int k = 0; k < depth; k++) {
+			for(int j = 0; j < GEMM_NR; j++) {
+				r0 = start + s * GEMM_NR + j;
+				tile[k * GEMM_NR + j] = r0 >= order ? 0.0 : k < width ?
+					vs[COORD(k, r0, order)] :
+					ws[COORD(k - width, r0, order)];
+			}
+		}
+	}
+	synchronize(threads_amount);
+
+	// The panels of rows shrink towards the end, they are dealt in turn
+	for(int s = thread_id; s < row_panels; s += threads_amount) {
+		r0 = start + s * GEMM_NR;
+		for(int q = s * GEMM_NR / GEMM_MR; q < column_panels; q++) {
+			c0 = start + q * GEMM_MR;
+			if(!packed && r0 + GEMM_NR <= order && c0 + GEMM_MR <= order) {
+				gemm_kernel(depth, packed_a + (size_t)q * GEMM_MR * depth,
+					packed_b + (size_t)s * GEMM_NR * depth, matrix +
+					COORD(r0, c0, order), order);
+				continue;
+			}
+
+			// Edge of the matrix or packed rows: compute the whole block
+			// aside
+			memset(edge, 0, sizeof(edge));
+			gemm_kernel(depth, packed_a + (size_t)q * GEMM_MR * depth,
+				packed_b + (size_t)s * GEMM_NR * depth, edge, GEMM_MR);
+			for(int j = 0; j < MIN(GEMM_NR, order - r0); j++) {
+				row = upper_row(matrix, order, packed, r0 + j);
+				for(int i = MAX(0, r0 + j - c0); i < MIN(GEMM_MR,
+					order - c0); i++) {
+					row[c0 + i - r0 - j] += edge[COORD(j, i, GEMM_MR)];
+				}
+			}
+		}
+	}
+	synchronize(threads_amount);
+}
+
+// Blocked reduction in the manner of LAPACK dsytrd: only the upper triangle
+// is read and written, or the same elements of the packed lower one. Within
+// a panel of HOUSEHOLDER_BLOCK steps the matrix is kept as
+// A - V W^T - W V^T, row i is brought up to date only when step i needs
+// it, and the trailing matrix gets the whole rank-2k update once per panel
+void reduce_householder(double *matrix, int order, int packed, double *work,
+		int thread_id, int threads_amount) {
+	double *vs = work, *ws = vs + (size_t)HOUSEHOLDER_BLOCK * order;
+	double *packed_a = ws + (size_t)HOUSEHOLDER_BLOCK * order;
+	double *packed_b = packed_a + (size_t)HOUSEHOLDER_BLOCK * 2 * (order +
+		GEMM_MR);
+	double *partials = packed_b + (size_t)HOUSEHOLDER_BLOCK * 2 * (order +
+		GEMM_NR);
+	double *y = partials + (size_t)thread_id * order;
+	double products_w[HOUSEHOLDER_BLOCK], products_v[HOUSEHOLDER_BLOCK];
+	double *row, *v, *w, tau, scale;
+	int width, length, first, last;
+
+	for(int panel = 0; panel < order - 2; panel += width) {
+		width = MIN(HOUSEHOLDER_BLOCK, order - 2 - panel);
+		for(int l = 0; l < width; l++) {
+			int i = panel + l;
+			v = vs + COORD(l, 0, order);
+			w = ws + COORD(l, 0, order);
+			length = order - i - 1;
+
+			if(thread_id == 0) {
+				row = upper_row(matrix, order, packed, i);
+				for(int m = 0; m < l; m++) {
+					vector_axpy(-vs[COORD(m, i, order)], ws + COORD(m, i,
+						order), row, order - i);
+					vector_axpy(-ws[COORD(m, i, order)], vs + COORD(m, i,
+						order), row, order - i);
+				}
+				// Index i of v is not used, it keeps tau
+				make_reflector(row + 1, length, v + i + 1, v + i);
+			}
+			synchronize(threads_amount);
+			tau = v[i];
+
+			// y = A v from the upper triangle, by rows in turn
+			memset(y + i + 1, 0, length * sizeof(double));
+			for(int r = i + 1 + thread_id; r < order; r += threads_amount) {
+				row = upper_row(matrix, order, packed, r);
+				y[r] += vector_dot(row, v + r, order - r);
+				vector_axpy(v[r], row + 1, y + r + 1, order - r - 1);
+			}
+			synchronize(threads_amount);
+
+			// w = tau (A - V W^T - W V^T) v on the part of the thread
+			for(int m = 0; m < l; m++) {
+				products_w[m] = vector_dot(ws + COORD(m, i + 1, order),
+					v + i + 1, length);
+				products_v[m] = vector_dot(vs + COORD(m, i + 1, order),
+					v + i + 1, length);
+			}
+			thread_range(i + 1, order, thread_id, threads_amount, &first,
+				&last);
+			for(int c = first; c < last; c++) {
+				w[c] = 0.0;
+				for(int t = 0; t < threads_amount; t++) {
+					w[c] += partials[COORD(t, c, order)];
+				}
+			}
+			for(int m = 0; m < l; m++) {
+				vector_axpy(-products_w[m], vs + COORD(m, first, order),
+					w + first, last - first);
+				vector_axpy(-products_v[m], ws + COORD(m, first, order),
+					w + first, last - first);
+			}
+			for(int c = first; c < last; c++) {
+				w[c] *= tau;
+			}
+			// Index i of y is not used, it keeps the part of w^T v
+			y[i] = vector_dot(w + first, v + first, last - first);
+			synchronize(threads_amount);
+
+			// w -= tau / 2 (w^T v) v
+			scale = 0.0;
+			for(int t = 0; t < threads_amount; t++) {
+				scale += partials[COORD(t, i, order)];
+			}
+			scale *= -0.5 * tau;
+			vector_axpy(scale, v + first, w + first, last - first);
+			synchronize(threads_amount);
+		}
+
+		update_trailing(matrix, order, packed, panel + width, width, vs, ws,
+			packed_a, packed_b, thread_id, threads_amount);
+	}
+}
+
+static inline int eigenvalues_body(double *matrix, double *values,
+		int *iterations, int order, double eps) {
+	double temp1, temp2;
+	double cos_phi = 0.0, sin_phi = 0.0;
+	double norm = infinity_norm(matrix, order, 0);
 
-	memset(values, 0, order * sizeof(int));
-	
 	// Cast to three-diagonal type
 	for(int i = 0; i < order - 2; i++) {
 		// Working with vector (matrix[i, i + 1], ..., matrix[i, order])
@@ -56,16 +415,15 @@ int get_eigenvalues(double *matrix, double *values, int order, double eps) {
 			matrix[COORD(j, i, order)] = 0.0;
 
 
-			// Multiply matrix by T from left
+			// Multiply matrix by T from left, the small orders are too
+			// short for the vector kernel call to pay off
 			for(int k = i + 1; k < order; k++) {
-				// We need to preserve matrix[k, i + 1] value
-				temp1 =
-					matrix[COORD(i + 1, k, order)] * cos_phi -
-					matrix[COORD(j, k, order)] * sin_phi;
-				matrix[COORD(j, k, order)] = 
-					matrix[COORD(i + 1, k, order)] * sin_phi +
-					matrix[COORD(j, k, order)] * cos_phi;
-				matrix[COORD(i + 1, k, order)] = temp1;
+				temp1 = matrix[COORD(i + 1, k, order)];
+				temp2 = matrix[COORD(j, k, order)];
+				matrix[COORD(i + 1, k, order)] = cos_phi * temp1 -
+					sin_phi * temp2;
+				matrix[COORD(j, k, order)] = sin_phi * temp1 +
+					cos_phi * temp2;
 			}
 
 
@@ -101,6 +459,17 @@ int get_eigenvalues(double *matrix, double *values, int order, double eps) {
 		}
 	}
 
+	relocate_tridiagonal(matrix, order);
+	return tridiagonal_eigenvalues(matrix, matrix + order, values, iterations,
+		order, eps, norm);
+}
+
+// The diagonal goes to the first order elements of the matrix and the
+// subdiagonal to the next order ones
+static inline void relocate_tridiagonal(double *matrix, int order) {
+	double *main_diag = matrix;
+	double *lower_diag = matrix + order;
+
 	// relocate elements for easier code and speed
 	for(int i = 1; i < order - 1; i++) {
 		main_diag[i] = matrix[COORD(i, i, order)];
@@ -108,132 +477,30 @@ int get_eigenvalues(double *matrix, double *values, int order, double eps) {
 	}
 	main_diag[order - 1] = matrix[COORD(order - 1, order - 1, order)];
 	lower_diag[order - 1] = 0.0;
-
-	// Obtain eigenvalues
-	for(int i = order - 1; i > 1; i--) {
-		while(fabs(lower_diag[i - 1]) >= eps * norm) {
-			temp1 = main_diag[i];  // Shift
-			for(int j = 0; j <= i; j++) {
-				main_diag[j] -= temp1;
-			}
-			//printf("\r");
-			//printf("%lf", lower_diag[i - 1]);
-
-			// QR decomposition (and computation of RQ at the same time)
-			if(fabs(lower_diag[0]) >= 1e-16) { 
-				temp2 = sqrt(SQUARE(main_diag[0]) +
-					SQUARE(lower_diag[0]));
-				temp3 = 1 / temp2;
-
-				cos_phi = main_diag[0] * temp3;
-				sin_phi = -lower_diag[0] * temp3;
-
-				main_diag[0] = temp2;
-
-				temp4 = lower_diag[0] * cos_phi -
-					main_diag[1] * sin_phi; // 0-th elem of upper diag
-				main_diag[1] = lower_diag[0] * sin_phi +
-					main_diag[1] * cos_phi;
-
-				lower_diag[0] = temp4; // Upper diag
-
-				temp5 = lower_diag[1] * cos_phi; // 1-th elem of upper diag
-
-				cos_phi1 = cos_phi; sin_phi1 = sin_phi;
-			} else {
-				cos_phi1 = cos_phi = 1.0;
-				sin_phi1 = sin_phi = 0.0;
-				temp5 = lower_diag[1];
-			}
-
-			for(int k = 1; k <= i - 1; k++) {
-				if(fabs(lower_diag[k]) >= 1e-16){
-					temp2 = sqrt(SQUARE(main_diag[k]) +
-						SQUARE(lower_diag[k]));
-					temp3 = 1 / temp2;
-
-					cos_phi = main_diag[k] * temp3;
-					sin_phi = -lower_diag[k] * temp3;
-
-					// Multiply by T(k, k + 1) from left
-					main_diag[k] = temp2;
-					temp4 = temp5 * cos_phi-
-						main_diag[k + 1] * sin_phi;
-					main_diag[k + 1] = temp5 * sin_phi +
-						main_diag[k + 1] * cos_phi;
-					lower_diag[k] = temp4;
-
-					temp5 = lower_diag[k + 1] * cos_phi;
-				} else {
-					cos_phi = 1.0; sin_phi = 1.0;
-					temp5 = lower_diag[k + 1];
-				}
-
-				// Multiply by T(k - 1, k)* from right
-				main_diag[k - 1] = main_diag[k - 1] * cos_phi1 -
-					lower_diag[k - 1] * sin_phi1;
-
-				// Corresponding upper diagonal element will be just
-				// lower_diag[k - 1] * cos_phi
-				lower_diag[k - 1] = - main_diag[k] * sin_phi1;
-				main_diag[k] *= cos_phi1;
-
-				cos_phi1 = cos_phi;
-				sin_phi1 = sin_phi;
-			}
-
-			// Last iteration
-			main_diag[i - 1] = main_diag[i - 1] * cos_phi1 - 
-				lower_diag[i - 1] * sin_phi1;
-			
-			lower_diag[i - 1] = -main_diag[i] * sin_phi1;
-			main_diag[i] = main_diag[i] * cos_phi1;
-
-			// Shift back
-			for(int j = 0; j <= i; j++) {
-				main_diag[j] += temp1;
-			}
-		}
-		values[i] = main_diag[i];
-		lower_diag[i - 1] = 0.0;
-	}
-	// Last two eigenvalues are found as solutions of quadratic equation
-	temp1 = sqrt(SQUARE(main_diag[0] - main_diag[1])
-		+ 4 * SQUARE(lower_diag[0]));
-	values[1] = (main_diag[0] + main_diag[1] - temp1) / 2.0;
-	values[0] = (main_diag[0] + main_diag[1] + temp1) / 2.0;
-	return 0;
 }
 
-double residual1(double *matrix, double *eigenvalues, int order) {
-	double result = 0.0;
-	for(int i = 0; i < order; i++) {
-		result += (matrix[COORD(i, i, order)] - eigenvalues[i]);
-	}
-	return fabs(result);
-}
+void matrix_norms(const double *matrix, int order, int packed,
+		double *trace, double *norm) {
+	double square = 0.0;
 
-double residual2(double *matrix, double *eigenvalues, int order) {
-	double result = 0.0, result1 = 0.0;
-	for(int i = 0; i < SQUARE(order); i++) {
-		result += SQUARE(matrix[i]);
-	}
-	result = sqrt(result);
+	*trace = 0.0;
 	for(int i = 0; i < order; i++) {
-		result1 += SQUARE(eigenvalues[i]);
+		*trace += ELEMENT(matrix, i, i, order, packed);
+		for(int j = 0; j < order; j++) {
+			square += SQUARE(ELEMENT(matrix, i, j, order, packed));
+		}
 	}
-	result1 = sqrt(result1);
-	return fabs(result - result1);
+	*norm = sqrt(square);
 }
 
-double infinity_norm(const double *matrix, int order) {
+double infinity_norm(const double *matrix, int order, int packed) {
 	double t;
 	double result = -1.0;
 
 	for(int i = 0; i < order; i++) {
 		t = 0.0;
 		for(int j = 0; j < order; j++) {
-			t += fabs(matrix[COORD(i, j, order)]);
+			t += fabs(ELEMENT(matrix, i, j, order, packed));
 		}
 		result = MAX(result, t);
 	}
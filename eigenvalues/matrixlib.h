@@ -16,10 +16,46 @@
 
 #pragma once
 
-int get_eigenvalues(double *matrix, double *values, int order, double eps);
+#include <stddef.h>
 
-double infinity_norm(const double *matrix, int order);
+// Reductions to tridiagonal form
+#define REDUCTION_GIVENS 0
+#define REDUCTION_HOUSEHOLDER 1
 
-double residual1(double *matrix, double *eigenvalues, int order);
+// Solvers of the tridiagonal matrix
+#define SOLVER_QR 0
+#define SOLVER_DIVIDE 1
 
-double residual2(double *matrix, double *eigenvalues, int order);
\ No newline at end of file
+// Steps of a panel of reduce_householder()
+#define HOUSEHOLDER_BLOCK 32
+
+// Returns 1 if the QR steps do not converge, 2 if memory cannot be
+// allocated. iterations[i] is the number of QR steps spent on values[i]
+int get_eigenvalues(double *matrix, double *values, int *iterations,
+		int order, double eps);
+
+// Diagonal and subdiagonal of the matrix reduced by reduce_tridiagonal() or
+// reduce_householder()
+void tridiagonal_part(double *matrix, int order, int packed,
+		double *diagonal, double *subdiagonal);
+
+// Reduces the matrix to tridiagonal form by Givens rotations, every one of
+// threads_amount threads calls it, rotations holds 2 * order doubles per
+// thread
+void reduce_tridiagonal(double *matrix, int order, double *rotations,
+		int thread_id, int threads_amount);
+
+// Reduces the matrix to tridiagonal form by Householder reflectors, every
+// one of threads_amount threads calls it. Only the upper triangle is used,
+// or the lower one stored by columns if packed
+void reduce_householder(double *matrix, int order, int packed, double *work,
+		int thread_id, int threads_amount);
+
+// Doubles of work shared by threads_amount threads of reduce_householder()
+size_t householder_work_size(int order, int threads_amount);
+
+double infinity_norm(const double *matrix, int order, int packed);
+
+// Trace and Frobenius norm of the matrix for the residuals
+void matrix_norms(const double *matrix, int order, int packed,
+		double *trace, double *norm);
\ No newline at end of file
@@ -0,0 +1,174 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+
+#include "common.h"
+#include "structured.h"
+
+int formula_structure(int order, int formula_number, double *parameters) {
+	switch(formula_number) {
+		case 1:
+			parameters[0] = 1.0;
+			return STRUCTURE_REVERSED_MIN;
+		case 2:
+			parameters[0] = 2.0;
+			parameters[1] = -1.0;
+			return STRUCTURE_TRIDIAGONAL_TOEPLITZ;
+		case 3:
+			// The arrow is 1, 2, ..., n - 1 with the corner n
+			parameters[0] = 1.0;
+			parameters[1] = order;
+			parameters[2] = (double)(order - 1) * order * (2.0 * order - 1.0)
+				/ 6.0;
+			return STRUCTURE_ARROWHEAD;
+		default:
+			return STRUCTURE_NONE;
+	}
+}
+
+int matrix_structure(const double *matrix, int order, int packed,
+		double *parameters) {
+	int found;
+	double t;
+
+	// Tridiagonal Toeplitz
+	found = 1;
+	parameters[0] = ELEMENT(matrix, 0, 0, order, packed);
+	parameters[1] = order > 1 ? ELEMENT(matrix, 0, 1, order, packed) : 0.0;
+	for(int i = 0; i < order && found; i++) {
+		for(int j = 0; j < order; j++) {
+			t = ABS(i - j) > 1 ? 0.0 : parameters[ABS(i - j)];
+			if(ELEMENT(matrix, i, j, order, packed) != t) {
+				found = 0;
+				break;
+			}
+		}
+	}
+	if(found) {
+		return STRUCTURE_TRIDIAGONAL_TOEPLITZ;
+	}
+
+	// Arrowhead with the constant diagonal
+	found = 1;
+	parameters[0] = ELEMENT(matrix, 0, 0, order, packed);
+	parameters[1] = ELEMENT(matrix, order - 1, order - 1, order, packed);
+	parameters[2] = 0.0;
+	for(int i = 0; i < order - 1 && found; i++) {
+		for(int j = 0; j < order - 1; j++) {
+			if(ELEMENT(matrix, i, j, order, packed) !=
+				(i == j ? parameters[0] : 0.0)) {
+				found = 0;
+				break;
+			}
+		}
+		if(ELEMENT(matrix, i, order - 1, order, packed) !=
+			ELEMENT(matrix, order - 1, i, order, packed)) {
+			found = 0;
+		}
+		parameters[2] += SQUARE(ELEMENT(matrix, i, order - 1, order,
+			packed));
+	}
+	if(found) {
+		return STRUCTURE_ARROWHEAD;
+	}
+
+	// Reversed min(i, j) matrix
+	found = 1;
+	parameters[0] = ELEMENT(matrix, order - 1, order - 1, order, packed);
+	for(int i = 0; i < order && found; i++) {
+		for(int j = 0; j < order; j++) {
+			if(ELEMENT(matrix, i, j, order, packed) !=
+				parameters[0] * (order - MAX(i, j))) {
+				found = 0;
+				break;
+			}
+		}
+	}
+	if(found) {
+		return STRUCTURE_REVERSED_MIN;
+	}
+
+	return STRUCTURE_NONE;
+}
+
+void structured_eigenvalues(int structure, const double *parameters,
+		double *values, int order) {
+	double t;
+
+	switch(structure) {
+		case STRUCTURE_TRIDIAGONAL_TOEPLITZ:
+			// a + 2 b cos(k pi / (n + 1)), k = 1, ..., n
+			for(int k = 0; k < order; k++) {
+				values[k] = parameters[0] + 2.0 * parameters[1] *
+					cos((k + 1) * M_PI / (order + 1));
+			}
+			break;
+		case STRUCTURE_ARROWHEAD:
+			// d is repeated n - 2 times, the other two are the roots of
+			// (lambda - d)(lambda - alpha) = |z|^2
+			if(order == 1) {
+				values[0] = parameters[1];
+				break;
+			}
+			t = sqrt(SQUARE(parameters[1] - parameters[0]) +
+				4.0 * parameters[2]);
+			values[0] = (parameters[0] + parameters[1] + t) / 2.0;
+			values[1] = (parameters[0] + parameters[1] - t) / 2.0;
+			for(int k = 2; k < order; k++) {
+				values[k] = parameters[0];
+			}
+			break;
+		case STRUCTURE_REVERSED_MIN:
+			// The inverse is the second difference with 1 in a corner:
+			// c / (4 sin^2((2 k - 1) pi / (2 (2 n + 1)))), k = 1, ..., n
+			for(int k = 0; k < order; k++) {
+				t = sin((2 * k + 1) * M_PI / (2.0 * (2 * order + 1)));
+				values[k] = parameters[0] / (4.0 * t * t);
+			}
+			break;
+	}
+}
+
+void structured_norms(int structure, const double *parameters, int order,
+		double *trace, double *norm) {
+	double square = 0.0;
+
+	switch(structure) {
+		case STRUCTURE_TRIDIAGONAL_TOEPLITZ:
+			*trace = order * parameters[0];
+			square = order * SQUARE(parameters[0]) +
+				2.0 * (order - 1) * SQUARE(parameters[1]);
+			break;
+		case STRUCTURE_ARROWHEAD:
+			*trace = (order - 1) * parameters[0] + parameters[1];
+			square = (order - 1) * SQUARE(parameters[0]) +
+				SQUARE(parameters[1]) + 2.0 * parameters[2];
+			break;
+		case STRUCTURE_REVERSED_MIN:
+			// Value c t is taken 2 (n - t) + 1 times, t = 1, ..., n
+			*trace = parameters[0] * order * (order + 1.0) / 2.0;
+			for(int t = 1; t <= order; t++) {
+				square += (double)t * t * (2.0 * (order - t) + 1.0);
+			}
+			square *= SQUARE(parameters[0]);
+			break;
+		default:
+			*trace = 0.0;
+	}
+	*norm = sqrt(square);
+}
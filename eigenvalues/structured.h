@@ -0,0 +1,43 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+// Symmetric matrices with spectra known in closed form
+#define STRUCTURE_NONE 0
+// a on the main diagonal, b on the next ones
+#define STRUCTURE_TRIDIAGONAL_TOEPLITZ 1
+// d on the main diagonal except the last element alpha, the last row and
+// column hold z with |z|^2 = parameters[2]
+#define STRUCTURE_ARROWHEAD 2
+// A(i, j) = c (n - max(i, j) + 1)
+#define STRUCTURE_REVERSED_MIN 3
+
+// Structure of the formula matrix without forming it
+int formula_structure(int order, int formula_number, double *parameters);
+
+// Structure of the loaded matrix by one pass over it per candidate
+int matrix_structure(const double *matrix, int order, int packed,
+	double *parameters);
+
+// Eigenvalues in O(n) by the closed form
+void structured_eigenvalues(int structure, const double *parameters,
+	double *values, int order);
+
+// Trace and Frobenius norm of the structured matrix for the residuals
+void structured_norms(int structure, const double *parameters, int order,
+	double *trace, double *norm);
@@ -0,0 +1,219 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "tridiagonal.h"
+#include "common.h"
+
+// QR steps allowed per eigenvalue
+#define QR_ITERATIONS_MAX 60
+
+// The subdiagonal element is below the absolute tolerance or lost in the
+// rounding of its diagonal neighbours
+static inline int negligible(double element, double above, double below,
+		double tolerance) {
+	return fabs(element) < tolerance ||
+		fabs(element) <= DBL_EPSILON * (fabs(above) + fabs(below));
+}
+
+// A single element is an eigenvalue already
+static void push_block(struct tridiagonal_queue *queue, int first,
+		int last) {
+	if(first == last) {
+		queue->values[first] = queue->diagonal[first];
+		queue->iterations[first] = 0;
+		return;
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+	queue->blocks[2 * queue->blocks_amount] = first;
+	queue->blocks[2 * queue->blocks_amount + 1] = last;
+	queue->blocks_amount++;
+	pthread_cond_signal(&queue->condvar);
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+// Implicit QR steps with the Wilkinson shift on the unreduced block that
+// ends at the last eigenvalue of the block not found yet: the rotation of
+// the shifted first column makes a bulge below the subdiagonal, the next
+// rotations chase it down and out of the block
+static int solve_block(struct tridiagonal_queue *queue, int first,
+		int last) {
+	double *main_diag = queue->diagonal;
+	double *lower_diag = queue->subdiagonal;
+	double tolerance = queue->tolerance;
+	double delta, shift, x, z, r, cos_phi, sin_phi, temp1, temp2, temp3;
+	int low;
+
+	for(int i = last; i > first; i--) {
+		queue->iterations[i] = 0;
+		while(!negligible(lower_diag[i - 1], main_diag[i - 1], main_diag[i],
+			tolerance)) {
+			if(queue->iterations[i] == QR_ITERATIONS_MAX) {
+				return 1;
+			}
+			queue->iterations[i]++;
+
+			low = i - 1;
+			while(low > first && !negligible(lower_diag[low - 1],
+				main_diag[low - 1], main_diag[low], tolerance)) {
+				low--;
+			}
+
+			// The steps above the split do not touch the rows below it,
+			// another thread may take them
+			if(low > first) {
+				lower_diag[low - 1] = 0.0;
+				push_block(queue, first, low - 1);
+				first = low;
+			}
+
+			// Eigenvalue of the trailing 2 x 2 block closer to its last
+			// diagonal element
+			delta = (main_diag[i - 1] - main_diag[i]) / 2.0;
+			shift = main_diag[i] - SQUARE(lower_diag[i - 1]) / (delta +
+				(delta < 0.0 ? -1.0 : 1.0) * hypot(delta, lower_diag[i - 1]));
+
+			x = main_diag[low] - shift;
+			z = lower_diag[low];
+			for(int k = low; k < i; k++) {
+				r = hypot(x, z);
+				cos_phi = r == 0.0 ? 1.0 : x / r;
+				sin_phi = r == 0.0 ? 0.0 : z / r;
+				if(k > low) {
+					lower_diag[k - 1] = r;
+				}
+
+				// G^T T G on rows and columns k and k + 1
+				temp1 = main_diag[k];
+				temp2 = main_diag[k + 1];
+				temp3 = lower_diag[k];
+				main_diag[k] = SQUARE(cos_phi) * temp1 + 2.0 * cos_phi *
+					sin_phi * temp3 + SQUARE(sin_phi) * temp2;
+				main_diag[k + 1] = SQUARE(sin_phi) * temp1 - 2.0 * cos_phi *
+					sin_phi * temp3 + SQUARE(cos_phi) * temp2;
+				lower_diag[k] = cos_phi * sin_phi * (temp2 - temp1) +
+					(SQUARE(cos_phi) - SQUARE(sin_phi)) * temp3;
+
+				// The bulge moves to (k, k + 2)
+				if(k < i - 1) {
+					x = lower_diag[k];
+					z = sin_phi * lower_diag[k + 1];
+					lower_diag[k + 1] *= cos_phi;
+				}
+			}
+		}
+		queue->values[i] = main_diag[i];
+		lower_diag[i - 1] = 0.0;
+	}
+	queue->values[first] = main_diag[first];
+	queue->iterations[first] = 0;
+	return 0;
+}
+
+int tridiagonal_init(struct tridiagonal_queue *queue, double *diagonal,
+		double *subdiagonal, double *values, int *iterations, int order,
+		double tolerance) {
+	// The blocks do not overlap, so there are at most order of them
+	queue->blocks = (int*)malloc(2 * (size_t)order * sizeof(int));
+	if(!queue->blocks) {
+		return 2;
+	}
+	queue->diagonal = diagonal;
+	queue->subdiagonal = subdiagonal;
+	queue->values = values;
+	queue->iterations = iterations;
+	queue->order = order;
+	queue->tolerance = tolerance;
+	queue->blocks_amount = 0;
+	queue->active = 0;
+	queue->failed = 0;
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->condvar, NULL);
+	return 0;
+}
+
+void tridiagonal_free(struct tridiagonal_queue *queue) {
+	pthread_cond_destroy(&queue->condvar);
+	pthread_mutex_destroy(&queue->mutex);
+	free(queue->blocks);
+}
+
+void tridiagonal_split(struct tridiagonal_queue *queue) {
+	double *main_diag = queue->diagonal;
+	double *lower_diag = queue->subdiagonal;
+	int first = 0;
+
+	for(int i = 0; i < queue->order - 1; i++) {
+		if(negligible(lower_diag[i], main_diag[i], main_diag[i + 1],
+			queue->tolerance)) {
+			lower_diag[i] = 0.0;
+			push_block(queue, first, i);
+			first = i + 1;
+		}
+	}
+	push_block(queue, first, queue->order - 1);
+}
+
+void tridiagonal_solve(struct tridiagonal_queue *queue) {
+	int first, last, failed;
+
+	pthread_mutex_lock(&queue->mutex);
+	for(;;) {
+		// A block being solved may still give a part back
+		while(!queue->blocks_amount && queue->active) {
+			pthread_cond_wait(&queue->condvar, &queue->mutex);
+		}
+		if(!queue->blocks_amount) {
+			break;
+		}
+		queue->blocks_amount--;
+		first = queue->blocks[2 * queue->blocks_amount];
+		last = queue->blocks[2 * queue->blocks_amount + 1];
+		queue->active++;
+		pthread_mutex_unlock(&queue->mutex);
+
+		failed = solve_block(queue, first, last);
+
+		pthread_mutex_lock(&queue->mutex);
+		queue->failed |= failed;
+		queue->active--;
+		if(!queue->active && !queue->blocks_amount) {
+			pthread_cond_broadcast(&queue->condvar);
+		}
+	}
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+int tridiagonal_eigenvalues(double *diagonal, double *subdiagonal,
+		double *values, int *iterations, int order, double eps,
+		double norm) {
+	struct tridiagonal_queue queue;
+	int failed;
+
+	if(tridiagonal_init(&queue, diagonal, subdiagonal, values, iterations,
+		order, eps * norm)) {
+		return 2;
+	}
+	tridiagonal_split(&queue);
+	tridiagonal_solve(&queue);
+	failed = queue.failed;
+	tridiagonal_free(&queue);
+	return failed;
+}
@@ -0,0 +1,64 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+// Blocks of the tridiagonal matrix that wait for QR steps. A negligible
+// subdiagonal element splits the matrix into blocks with their own
+// eigenvalues, so every block is iterated on its own by whichever thread
+// takes it, and a block that splits during its steps gives its upper part
+// back to the queue
+struct tridiagonal_queue {
+	double *diagonal;
+	double *subdiagonal;
+	double *values;
+	int *iterations;
+	int order;
+	double tolerance;
+	int *blocks; // first and last index of every waiting block
+	int blocks_amount;
+	int active; // blocks taken and not solved yet
+	int failed;
+	pthread_mutex_t mutex;
+	pthread_cond_t condvar;
+};
+
+// Prepares the queue for the tridiagonal matrix of the given arrays,
+// tolerance is the absolute one for the subdiagonal elements. Returns 2 if
+// memory cannot be allocated
+int tridiagonal_init(struct tridiagonal_queue *queue, double *diagonal,
+		double *subdiagonal, double *values, int *iterations, int order,
+		double tolerance);
+
+void tridiagonal_free(struct tridiagonal_queue *queue);
+
+// Cuts the matrix at the negligible subdiagonal elements and queues the
+// blocks, called once before tridiagonal_solve()
+void tridiagonal_split(struct tridiagonal_queue *queue);
+
+// Called by every thread, returns when all blocks are solved. failed of
+// the queue is set if the QR steps of some block do not converge
+void tridiagonal_solve(struct tridiagonal_queue *queue);
+
+// Eigenvalues of the tridiagonal matrix by implicit QR steps with the
+// Wilkinson shift on one thread, subdiagonal[order - 1] is 0. Both arrays
+// are destroyed, norm is the infinity norm of the original matrix.
+// Returns 1 if the steps do not converge, 2 if memory cannot be allocated
+int tridiagonal_eigenvalues(double *diagonal, double *subdiagonal,
+		double *values, int *iterations, int order, double eps,
+		double norm);
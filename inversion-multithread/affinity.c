@@ -0,0 +1,167 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "affinity.h"
+
+int parse_list(const char *list, int *numbers, int max_amount) {
+	int amount = 0, first, last, length;
+
+	while(*list) {
+		if(sscanf(list, "%d%n", &first, &length) != 1 || first < 0) {
+			return -1;
+		}
+		list += length;
+		last = first;
+		if(*list == '-') {
+			list++;
+			if(sscanf(list, "%d%n", &last, &length) != 1 || last < first) {
+				return -1;
+			}
+			list += length;
+		}
+		for(int i = first; i <= last; i++) {
+			if(amount == max_amount) {
+				return -1;
+			}
+			numbers[amount++] = i;
+		}
+		if(*list == ',') {
+			list++;
+		} else if(*list && *list != '\n') {
+			return -1;
+		} else {
+			break;
+		}
+	}
+
+	return amount;
+}
+
+int node_cpus(const char *nodes, int *cpus, int max_amount) {
+	int node_list[MAX_NODES];
+	int nodes_amount, amount = 0, result;
+	char path[64], line[4096];
+	FILE *fin;
+
+	nodes_amount = parse_list(nodes, node_list, MAX_NODES);
+	if(nodes_amount < 1) {
+		return -1;
+	}
+
+	for(int i = 0; i < nodes_amount; i++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+			node_list[i]);
+		fin = fopen(path, "r");
+		if(!fin) {
+			return -1;
+		}
+		result = fgets(line, sizeof(line), fin) ? parse_list(line,
+			cpus + amount, max_amount - amount) : -1;
+		fclose(fin);
+		if(result < 0) {
+			return -1;
+		}
+		amount += result;
+	}
+
+	return amount;
+}
+
+int cpu_node(int cpu) {
+	char path[80];
+
+	for(int node = 0; node < MAX_NODES; node++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpu%d",
+			node, cpu);
+		if(!access(path, F_OK)) {
+			return node;
+		}
+	}
+
+	return 0;
+}
+
+int count_pages(const void *data, size_t size, int samples, long *pages) {
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t total = (size + page_size - 1) / page_size;
+	size_t step = total > (size_t)samples ? total / samples : 1;
+	int amount = (int)((total + step - 1) / step);
+	void **addresses;
+	int *status;
+	int result = 1;
+
+	for(int i = 0; i < MAX_NODES; i++) {
+		pages[i] = 0;
+	}
+
+	addresses = (void**)malloc(amount * sizeof(void*));
+	status = (int*)malloc(amount * sizeof(int));
+	if(addresses && status) {
+		for(int i = 0; i < amount; i++) {
+			addresses[i] = (void*)(((uintptr_t)data & ~(uintptr_t)(page_size -
+				1)) + i * step * page_size);
+		}
+		// Without target nodes move_pages() only reports where pages are
+		if(!syscall(SYS_move_pages, 0, (unsigned long)amount, addresses,
+			NULL, status, 0)) {
+			for(int i = 0; i < amount; i++) {
+				if(status[i] >= 0 && status[i] < MAX_NODES) {
+					pages[status[i]] += step;
+				}
+			}
+			result = 0;
+		}
+	}
+
+	free(status);
+	free(addresses);
+
+	return result;
+}
+
+double sweep_bandwidth(const double *data, size_t length) {
+	struct timespec begin, end;
+	volatile double sink;
+	double sum[4] = {0.0, 0.0, 0.0, 0.0}, seconds;
+	size_t i;
+
+	// Independent sums keep the loop bound by memory, not by the adder
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for(i = 0; i + 4 <= length; i += 4) {
+		sum[0] += data[i];
+		sum[1] += data[i + 1];
+		sum[2] += data[i + 2];
+		sum[3] += data[i + 3];
+	}
+	for(; i < length; i++) {
+		sum[0] += data[i];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	sink = sum[0] + sum[1] + sum[2] + sum[3];
+	(void)sink;
+
+	seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) /
+		1e9;
+
+	return seconds > 0.0 ? length * sizeof(double) / seconds / 1e9 : 0.0;
+}
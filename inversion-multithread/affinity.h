@@ -0,0 +1,42 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+// Upper bounds of the node numbers looked up in sysfs and of the CPUs
+// workers are pinned to
+#define MAX_NODES 64
+#define MAX_CPUS 1024
+
+// Parses a list like "0-3,8,10-11" into numbers, returns their amount or
+// -1 if the list is invalid or longer than max_amount
+int parse_list(const char *list, int *numbers, int max_amount);
+
+// Collects the CPUs of the nodes in the list, returns their amount or -1
+int node_cpus(const char *nodes, int *cpus, int max_amount);
+
+// Node of the CPU, 0 if the system does not tell
+int cpu_node(int cpu);
+
+// Counts the pages of data per node into pages[MAX_NODES], looking at no
+// more than samples pages spread evenly. Returns 1 if the kernel does not
+// tell where pages are
+int count_pages(const void *data, size_t size, int samples, long *pages);
+
+// Reads length elements and returns the speed in GB/s
+double sweep_bandwidth(const double *data, size_t length);
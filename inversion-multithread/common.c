@@ -15,26 +15,17 @@
  */
 
 #include <pthread.h>
-#include <sys/resource.h>
+#include <stdatomic.h>
+#include <time.h>
 
 #include "common.h"
 
-double f(int n, int k, int i, int j) {
-		switch (k) {
-		case 1:
-			return n - MAX(i, j) + 1;
-		case 2:
-			return MAX(i, j);
-		case 3:
-			return ABS(i - j);
-		case 4:
-			return 1.0/(double)(i + j - 1);
-		default:
-			return 0;
-	}
-}
+// Checks of the spinning barrier before the waiting thread parks
+#define BARRIER_SPINS 4096
 
-void synchronize(int threads_amount) {
+static int barrier_kind = BARRIER_BLOCKING;
+
+static void synchronize_blocking(int threads_amount) {
 	static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 	static pthread_cond_t condvar_in = PTHREAD_COND_INITIALIZER;
 	static pthread_cond_t condvar_out = PTHREAD_COND_INITIALIZER;
@@ -62,10 +53,146 @@ void synchronize(int threads_amount) {
 	pthread_mutex_unlock(&mutex);
 }
 
-long int get_thread_time(void) {
-	struct rusage buf;
+static void relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+static void synchronize_spinning(int threads_amount) {
+	static atomic_int threads_in = 0;
+	static atomic_int sense = 0;
+	static atomic_int threads_parked = 0;
+	static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	static pthread_cond_t condvar = PTHREAD_COND_INITIALIZER;
+	static _Thread_local int thread_sense = 0;
+
+	// Every pass waits for sense to become the opposite of the previous
+	// one, so the counter can be reset by the last thread at once
+	thread_sense = !thread_sense;
+	if(atomic_fetch_add(&threads_in, 1) == threads_amount - 1) {
+		atomic_store_explicit(&threads_in, 0, memory_order_relaxed);
+		atomic_store(&sense, thread_sense);
+		if(atomic_load(&threads_parked)) {
+			pthread_mutex_lock(&mutex);
+			pthread_cond_broadcast(&condvar);
+			pthread_mutex_unlock(&mutex);
+		}
+		return;
+	}
+
+	for(int i = 0; i < BARRIER_SPINS; i++) {
+		if(atomic_load_explicit(&sense, memory_order_acquire) ==
+				thread_sense) {
+			return;
+		}
+		relax();
+	}
+
+	// Park: the last thread either sees threads_parked or we see sense
+	pthread_mutex_lock(&mutex);
+	atomic_fetch_add(&threads_parked, 1);
+	while(atomic_load(&sense) != thread_sense) {
+		pthread_cond_wait(&condvar, &mutex);
+	}
+	atomic_fetch_sub(&threads_parked, 1);
+	pthread_mutex_unlock(&mutex);
+}
+
+void set_barrier(int kind) {
+	barrier_kind = kind;
+}
+
+void synchronize(int threads_amount) {
+	int phase;
+
+	if(threads_amount == 1) {
+		return;
+	}
+	phase = timing_phase(PHASE_WAIT);
+	if(barrier_kind == BARRIER_SPINNING) {
+		synchronize_spinning(threads_amount);
+	} else {
+		synchronize_blocking(threads_amount);
+	}
+	timing_phase(phase);
+}
 
-	getrusage(RUSAGE_SELF, &buf);
+void thread_columns(int start, int end, int block_size, int thread_id,
+		int threads_amount, int *first, int *last) {
+	int block, owner;
+
+	if(!block_size) {
+		*first = start + ((end - start) * thread_id) / threads_amount;
+		*last = start + ((end - start) * (thread_id + 1)) / threads_amount;
+		return;
+	}
+
+	block = start / block_size;
+	owner = block % threads_amount;
+	if(owner == thread_id) {
+		*first = start;
+	} else {
+		*first = (block + (thread_id - owner + threads_amount) %
+			threads_amount) * block_size;
+	}
+	*last = end;
+}
+
+int next_column(int column, int block_size, int threads_amount) {
+	column++;
+	if(block_size && column % block_size == 0) {
+		column += (threads_amount - 1) * block_size;
+	}
+
+	return column;
+}
+
+double get_thread_time(void) {
+	struct timespec buf;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &buf);
+
+	return buf.tv_sec + buf.tv_nsec / 1e9;
+}
+
+static _Thread_local struct thread_timing *timing = NULL;
+static _Thread_local int timing_current = PHASE_WAIT;
+static _Thread_local struct timespec timing_wall, timing_cpu;
+
+// Seconds since *last by clock, *last becomes now
+static double elapsed(clockid_t clock, struct timespec *last) {
+	struct timespec now;
+	double seconds;
+
+	clock_gettime(clock, &now);
+	seconds = (now.tv_sec - last->tv_sec) + (now.tv_nsec - last->tv_nsec) /
+		1e9;
+	*last = now;
+
+	return seconds;
+}
+
+void timing_start(struct thread_timing *thread_timing, int phase) {
+	timing = thread_timing;
+	timing_current = phase;
+	clock_gettime(CLOCK_MONOTONIC, &timing_wall);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &timing_cpu);
+}
+
+int timing_phase(int phase) {
+	int previous = timing_current;
+
+	if(timing) {
+		timing->wall[previous] += elapsed(CLOCK_MONOTONIC, &timing_wall);
+		timing->cpu[previous] += elapsed(CLOCK_THREAD_CPUTIME_ID, &timing_cpu);
+	}
+	timing_current = phase;
+
+	return previous;
+}
 
-	return buf.ru_utime.tv_sec * 100 + buf.ru_utime.tv_usec / 10000;
+void timing_stop(void) {
+	timing_phase(timing_current);
+	timing = NULL;
 }
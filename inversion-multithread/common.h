@@ -28,8 +28,51 @@
 
 #define EPS 1e-16
 
-double f(int n, int k, int i, int j);
+// Implementations of synchronize(): the blocking barrier sleeps on a
+// condition variable, the spinning one is a sense-reversing barrier that
+// spins for a while and only then parks. Spinning suits a thread per core,
+// blocking is for hosts with more threads than cores
+#define BARRIER_BLOCKING 0
+#define BARRIER_SPINNING 1
+
+// Selects the barrier, must be called before the threads start
+void set_barrier(int kind);
 
 void synchronize(int threads_amount);
 
-long get_thread_time(void);
+// Columns start..end - 1 of thread_id are first, next_column(first), ...
+// while below last. If block_size is 0 the columns are cut into contiguous
+// parts, else blocks of block_size columns are dealt to threads cyclically
+// by their number, so a column stays with its thread as start grows
+void thread_columns(int start, int end, int block_size, int thread_id,
+	int threads_amount, int *first, int *last);
+
+int next_column(int column, int block_size, int threads_amount);
+
+// CPU time of the calling thread in seconds
+double get_thread_time(void);
+
+// Phases of the per-thread timing
+#define PHASE_REFLECTOR 0 // building reflectors
+#define PHASE_TRAILING 1 // applying them to the rest of the matrix
+#define PHASE_RESULT 2 // applying them to the result
+#define PHASE_BACK 3 // back substitution
+#define PHASE_RESIDUAL 4
+#define PHASE_WAIT 5 // waiting for other threads
+#define PHASES_AMOUNT 6
+
+// Wall and CPU seconds of a thread per phase
+struct thread_timing {
+	double wall[PHASES_AMOUNT];
+	double cpu[PHASES_AMOUNT];
+};
+
+// The calling thread adds the time of its phases to timing from now on,
+// starting with phase. Without timing_start() the calls below do nothing
+void timing_start(struct thread_timing *timing, int phase);
+
+// Adds the time since the previous switch to the current phase, makes
+// phase current and returns the previous one
+int timing_phase(int phase);
+
+void timing_stop(void);
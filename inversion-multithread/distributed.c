@@ -0,0 +1,349 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "distributed.h"
+#include "kernels.h"
+#include "matrixio.h"
+#include "matrixlib.h"
+
+// Column i of R without its diagonal element is kept packed: i elements
+// from PACKED(i), the diagonal element follows them
+#define PACKED(i) ((size_t)(i) * ((i) + 1) / 2)
+
+// Header of a reflector message, the column of order elements follows it
+#define MESSAGE_STATE 0
+#define MESSAGE_DIAGONAL 1
+#define MESSAGE_HEADER 2
+
+// Returns 1 if the peer is gone
+static int send_all(int socket, const void *buffer, size_t size) {
+	const char *data = (const char*)buffer;
+	ssize_t sent;
+
+	while(size) {
+		sent = send(socket, data, size, MSG_NOSIGNAL);
+		if(sent < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return 1;
+		}
+		data += sent;
+		size -= sent;
+	}
+
+	return 0;
+}
+
+static int receive_all(int socket, void *buffer, size_t size) {
+	char *data = (char*)buffer;
+	ssize_t received;
+
+	while(size) {
+		received = recv(socket, data, size, 0);
+		if(received <= 0) {
+			if(received < 0 && errno == EINTR) {
+				continue;
+			}
+			return 1;
+		}
+		data += received;
+		size -= received;
+	}
+
+	return 0;
+}
+
+// Builds the reflector of local column c, which is global column i, and
+// sends it with the column of R to every other process
+static int publish_reflector(double *columns, double *message, int order,
+		int c, int i, int rank, int processes, const int *sockets) {
+	double *column = columns + COORD(c, 0, order);
+
+	message[MESSAGE_STATE] = make_reflector(column + i, order - i,
+		message + MESSAGE_DIAGONAL);
+	memcpy(message + MESSAGE_HEADER, column, order * sizeof(double));
+
+	for(int peer = 0; peer < processes; peer++) {
+		if(peer != rank && send_all(sockets[peer], message, (order +
+			MESSAGE_HEADER) * sizeof(double))) {
+			return 2;
+		}
+	}
+
+	return 0;
+}
+
+// Part of a process: inverts its columns into inverse, with its column
+// indices in global. Returns as distributed_invert()
+static int invert_part(double *columns, double *inverse, double *packed,
+		const int *global, const int *local_index, int local_amount,
+		int order, int block_size, int rank, int processes,
+		const int *sockets) {
+	double *buffers, *message, *own_message, *reflector;
+	int owner, result = 0;
+
+	// A received reflector and the own one sent ahead are kept apart
+	buffers = (double*)malloc(2 * (size_t)(order + MESSAGE_HEADER) *
+		sizeof(double));
+	if(!buffers) {
+		return 2;
+	}
+	own_message = buffers + order + MESSAGE_HEADER;
+
+	for(int c = 0; c < local_amount; c++) {
+		memset(inverse + COORD(c, 0, order), 0, order * sizeof(double));
+		inverse[COORD(c, global[c], order)] = 1.0;
+	}
+
+	if(local_index[0] >= 0 && (result = publish_reflector(columns,
+		own_message, order, local_index[0], 0, rank, processes, sockets))) {
+		goto free_buffers;
+	}
+
+	for(int i = 0; i < order; i++) {
+		owner = (i / block_size) % processes;
+		if(owner == rank) {
+			message = own_message;
+		} else {
+			message = buffers;
+			if(receive_all(sockets[owner], message, (order +
+				MESSAGE_HEADER) * sizeof(double))) {
+				result = 2;
+				goto free_buffers;
+			}
+		}
+		if(message[MESSAGE_STATE] != 0.0) {
+			result = 1; // non-invertible matrix
+			goto free_buffers;
+		}
+
+		memcpy(packed + PACKED(i), message + MESSAGE_HEADER, i *
+			sizeof(double));
+		packed[PACKED(i) + i] = message[MESSAGE_DIAGONAL];
+		reflector = message + MESSAGE_HEADER + i;
+
+		// Lookahead: the owner of the next column sends its reflector
+		// before updating the rest of its columns
+		if(i + 1 < order && local_index[i + 1] >= 0) {
+			vector_reflect(2.0, reflector, columns + COORD(local_index[i + 1],
+				i, order), order - i);
+			// The own message is still needed when it is the current one
+			if(message == own_message) {
+				memcpy(buffers, own_message, (order + MESSAGE_HEADER) *
+					sizeof(double));
+				reflector = buffers + MESSAGE_HEADER + i;
+			}
+			if((result = publish_reflector(columns, own_message, order,
+				local_index[i + 1], i + 1, rank, processes, sockets))) {
+				goto free_buffers;
+			}
+		}
+
+		for(int c = 0; c < local_amount; c++) {
+			if(global[c] > i + 1) {
+				vector_reflect(2.0, reflector, columns + COORD(c, i, order),
+					order - i);
+			}
+			vector_reflect(2.0, reflector, inverse + COORD(c, i, order),
+				order - i);
+		}
+	}
+
+	// Back substitution of Gaussian method for the own columns
+	for(int c = 0; c < local_amount; c++) {
+		for(int i = order - 1; i >= 0; i--) {
+			inverse[COORD(c, i, order)] /= packed[PACKED(i) + i];
+			vector_axpy(-inverse[COORD(c, i, order)], packed + PACKED(i),
+				inverse + COORD(c, 0, order), i);
+		}
+	}
+
+	free_buffers:
+	free(buffers);
+
+	return result;
+}
+
+// Runs the part of rank, the root gathers the inverse into result
+static int run_rank(double *result, int order, int formula_number,
+		char *filename, int block_size, int rank, int processes,
+		const int *sockets) {
+	double *columns, *inverse, *packed;
+	int *global, *local_index;
+	int local_amount = 0, first, last, code = 0;
+
+	thread_columns(0, order, block_size, rank, processes, &first, &last);
+	for(int j = first; j < last; j = next_column(j, block_size, processes)) {
+		local_amount++;
+	}
+
+	global = (int*)malloc((local_amount + order) * sizeof(int));
+	columns = (double*)malloc(2 * (size_t)local_amount * order *
+		sizeof(double));
+	packed = (double*)malloc((size_t)PACKED(order) * sizeof(double));
+	if(!global || !columns || !packed) {
+		code = 2;
+		goto free_arrays;
+	}
+	local_index = global + local_amount;
+	inverse = columns + (size_t)local_amount * order;
+
+	for(int j = 0; j < order; j++) {
+		local_index[j] = -1;
+	}
+	local_amount = 0;
+	for(int j = first; j < last; j = next_column(j, block_size, processes)) {
+		local_index[j] = local_amount;
+		global[local_amount++] = j;
+	}
+
+	if(filename) {
+		if(read_columns(columns, order, filename, local_index)) {
+			code = 2;
+			goto free_arrays;
+		}
+	} else {
+		for(int c = 0; c < local_amount; c++) {
+			fill_column(columns + COORD(c, 0, order), order, formula_number,
+				global[c]);
+		}
+	}
+
+	code = invert_part(columns, inverse, packed, global, local_index,
+		local_amount, order, block_size, rank, processes, sockets);
+	if(code) {
+		goto free_arrays;
+	}
+
+	// Gather the inverse, every process knows which columns the others own
+	if(rank) {
+		if(send_all(sockets[0], inverse, (size_t)local_amount * order *
+			sizeof(double))) {
+			code = 2;
+		}
+		goto free_arrays;
+	}
+	for(int c = 0; c < local_amount; c++) {
+		memcpy(result + COORD(global[c], 0, order), inverse + COORD(c, 0,
+			order), order * sizeof(double));
+	}
+	for(int peer = 1; peer < processes && !code; peer++) {
+		thread_columns(0, order, block_size, peer, processes, &first, &last);
+		for(int j = first; j < last; j = next_column(j, block_size,
+				processes)) {
+			if(receive_all(sockets[peer], result + COORD(j, 0, order), order *
+				sizeof(double))) {
+				code = 2;
+				break;
+			}
+		}
+	}
+
+	free_arrays:
+	free(packed);
+	free(columns);
+	free(global);
+
+	return code;
+}
+
+int distributed_invert(double *result, int order, int formula_number,
+		char *filename, int processes, int block_size) {
+	int *sockets, pair[2], created = 0, code, status;
+	pid_t *children;
+
+	// sockets[COORD(a, b, processes)] is the end of a to talk to b
+	sockets = (int*)malloc((size_t)processes * processes * sizeof(int));
+	children = (pid_t*)malloc(processes * sizeof(pid_t));
+	if(!sockets || !children) {
+		free(sockets);
+		free(children);
+		return 2;
+	}
+	for(int i = 0; i < processes * processes; i++) {
+		sockets[i] = -1;
+	}
+
+	code = 0;
+	for(int a = 0; a < processes && !code; a++) {
+		for(int b = a + 1; b < processes; b++) {
+			if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair)) {
+				code = 2;
+				break;
+			}
+			sockets[COORD(a, b, processes)] = pair[0];
+			sockets[COORD(b, a, processes)] = pair[1];
+		}
+	}
+
+	// Buffered output would be written by the children too
+	fflush(stdout);
+	fflush(stderr);
+	for(created = 1; created < processes && !code; created++) {
+		children[created] = fork();
+		if(children[created] < 0) {
+			code = 2;
+			break;
+		}
+		if(children[created] == 0) {
+			for(int i = 0; i < processes * processes; i++) {
+				if(i / processes != created && sockets[i] >= 0) {
+					close(sockets[i]);
+				}
+			}
+			_exit(run_rank(NULL, order, formula_number, filename, block_size,
+				created, processes, sockets + COORD(created, 0, processes)));
+		}
+	}
+
+	for(int i = processes; i < processes * processes; i++) {
+		if(sockets[i] >= 0) {
+			close(sockets[i]);
+		}
+	}
+	if(!code) {
+		code = run_rank(result, order, formula_number, filename, block_size,
+			0, processes, sockets);
+	}
+	// Closed sockets make the children still waiting for the root fail
+	for(int i = 0; i < processes; i++) {
+		if(sockets[i] >= 0) {
+			close(sockets[i]);
+		}
+	}
+
+	for(int i = 1; i < created; i++) {
+		if(waitpid(children[i], &status, 0) < 0 || !WIFEXITED(status) ||
+			(WEXITSTATUS(status) && !code)) {
+			code = code ? code : 2;
+		}
+	}
+
+	free(children);
+	free(sockets);
+
+	return code;
+}
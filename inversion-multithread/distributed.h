@@ -0,0 +1,32 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Columns per block of the distribution when none is given
+#define DISTRIBUTED_BLOCK_SIZE 8
+
+// Inverts the matrix of the formula or the file in processes cooperating
+// processes, the calling one being the root. Blocks of block_size columns
+// are dealt to processes cyclically, every process reads or generates only
+// its own columns and keeps only them and its columns of the result.
+// Processes are connected by Unix-domain socket pairs and exchange nothing
+// but messages: the owner of a column sends its reflector with the column of
+// R to all others, and in the end the columns of the inverse are gathered
+// into result of the root. Returns 1 if the matrix is not invertible, 2 if
+// there is not enough memory or a process failed
+int distributed_invert(double *result, int order, int formula_number,
+	char *filename, int processes, int block_size);
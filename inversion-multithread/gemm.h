@@ -0,0 +1,32 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Blocking of the packed multiplication: panels of A are GEMM_MC x GEMM_KC
+// (L2), panels of B are GEMM_KC x GEMM_NC (L3), see kernels.h for the
+// register block
+#define GEMM_MC 192
+#define GEMM_KC 256
+#define GEMM_NC 3072
+
+// C = A B for the m x depth matrix A and the depth x n matrix B, all stored
+// by columns with the given leading dimensions. Columns of C are split
+// between threads_amount callers, the call computes the part of thread_id.
+// Returns 2 if there is not enough memory for the packed panels
+int multiply_matrices(const double *a, int lda, const double *b, int ldb,
+		double *c, int ldc, int m, int n, int depth, int thread_id,
+		int threads_amount);
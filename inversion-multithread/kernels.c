@@ -0,0 +1,398 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define X86_KERNELS
+#endif
+
+#include "kernels.h"
+
+static double dot_scalar(const double *x, const double *y, int n);
+static void axpy_scalar(double a, const double *x, double *y, int n);
+static void reflect_scalar(double scale, const double *v, double *y, int n);
+static void rotate_scalar(double c, double s, double *x, double *y, int n);
+static void gemm_kernel_scalar(int depth, const double *a, const double *b,
+	double *c, int ldc);
+
+double (*vector_dot)(const double *x, const double *y, int n) = dot_scalar;
+void (*vector_axpy)(double a, const double *x, double *y, int n) =
+	axpy_scalar;
+void (*vector_reflect)(double scale, const double *v, double *y, int n) =
+	reflect_scalar;
+void (*vector_rotate)(double c, double s, double *x, double *y, int n) =
+	rotate_scalar;
+void (*gemm_kernel)(int depth, const double *a, const double *b, double *c,
+	int ldc) = gemm_kernel_scalar;
+
+// Scalar variants
+
+static double dot_scalar(const double *x, const double *y, int n) {
+	double s = 0.0;
+	for(int k = 0; k < n; k++) {
+		s += x[k] * y[k];
+	}
+	return s;
+}
+
+static void axpy_scalar(double a, const double *x, double *y, int n) {
+	for(int k = 0; k < n; k++) {
+		y[k] += a * x[k];
+	}
+}
+
+static void reflect_scalar(double scale, const double *v, double *y, int n) {
+	axpy_scalar(-scale * dot_scalar(v, y, n), v, y, n);
+}
+
+static void rotate_scalar(double c, double s, double *x, double *y, int n) {
+	double t;
+	for(int k = 0; k < n; k++) {
+		t = c * x[k] - s * y[k];
+		y[k] = s * x[k] + c * y[k];
+		x[k] = t;
+	}
+}
+
+static void gemm_kernel_scalar(int depth, const double *a, const double *b,
+		double *c, int ldc) {
+	double acc[GEMM_NR][GEMM_MR] = {{0.0}};
+	for(int l = 0; l < depth; l++) {
+		for(int j = 0; j < GEMM_NR; j++) {
+			for(int i = 0; i < GEMM_MR; i++) {
+				acc[j][i] += a[l * GEMM_MR + i] * b[l * GEMM_NR + j];
+			}
+		}
+	}
+	for(int j = 0; j < GEMM_NR; j++) {
+		for(int i = 0; i < GEMM_MR; i++) {
+			c[j * ldc + i] += acc[j][i];
+		}
+	}
+}
+
+#ifdef X86_KERNELS
+
+// SSE2 variants: two lanes, two accumulators
+
+__attribute__((target("sse2")))
+static double dot_sse2(const double *x, const double *y, int n) {
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	double s[2];
+	int k = 0;
+	for(; k + 3 < n; k += 4) {
+		s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x + k),
+			_mm_loadu_pd(y + k)));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x + k + 2),
+			_mm_loadu_pd(y + k + 2)));
+	}
+	_mm_storeu_pd(s, _mm_add_pd(s0, s1));
+	s[0] += s[1];
+	for(; k < n; k++) {
+		s[0] += x[k] * y[k];
+	}
+	return s[0];
+}
+
+__attribute__((target("sse2")))
+static void axpy_sse2(double a, const double *x, double *y, int n) {
+	__m128d va = _mm_set1_pd(a);
+	int k = 0;
+	for(; k + 1 < n; k += 2) {
+		_mm_storeu_pd(y + k, _mm_add_pd(_mm_loadu_pd(y + k),
+			_mm_mul_pd(va, _mm_loadu_pd(x + k))));
+	}
+	for(; k < n; k++) {
+		y[k] += a * x[k];
+	}
+}
+
+__attribute__((target("sse2")))
+static void reflect_sse2(double scale, const double *v, double *y, int n) {
+	axpy_sse2(-scale * dot_sse2(v, y, n), v, y, n);
+}
+
+__attribute__((target("sse2")))
+static void rotate_sse2(double c, double s, double *x, double *y, int n) {
+	__m128d vc = _mm_set1_pd(c), vs = _mm_set1_pd(s), vx, vy;
+	double t;
+	int k = 0;
+	for(; k + 1 < n; k += 2) {
+		vx = _mm_loadu_pd(x + k);
+		vy = _mm_loadu_pd(y + k);
+		_mm_storeu_pd(x + k, _mm_sub_pd(_mm_mul_pd(vc, vx),
+			_mm_mul_pd(vs, vy)));
+		_mm_storeu_pd(y + k, _mm_add_pd(_mm_mul_pd(vs, vx),
+			_mm_mul_pd(vc, vy)));
+	}
+	for(; k < n; k++) {
+		t = c * x[k] - s * y[k];
+		y[k] = s * x[k] + c * y[k];
+		x[k] = t;
+	}
+}
+
+// AVX2 + FMA variants: four lanes, four accumulators
+
+__attribute__((target("avx2,fma")))
+static double dot_avx2(const double *x, const double *y, int n) {
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	__m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+	__m128d h;
+	double s;
+	int k = 0;
+	for(; k + 15 < n; k += 16) {
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k),
+			_mm256_loadu_pd(y + k), s0);
+		s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k + 4),
+			_mm256_loadu_pd(y + k + 4), s1);
+		s2 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k + 8),
+			_mm256_loadu_pd(y + k + 8), s2);
+		s3 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k + 12),
+			_mm256_loadu_pd(y + k + 12), s3);
+	}
+	for(; k + 3 < n; k += 4) {
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k),
+			_mm256_loadu_pd(y + k), s0);
+	}
+	s0 = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+	h = _mm_add_pd(_mm256_castpd256_pd128(s0), _mm256_extractf128_pd(s0, 1));
+	s = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+	for(; k < n; k++) {
+		s += x[k] * y[k];
+	}
+	return s;
+}
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2(double a, const double *x, double *y, int n) {
+	__m256d va = _mm256_set1_pd(a);
+	int k = 0;
+	for(; k + 7 < n; k += 8) {
+		_mm256_storeu_pd(y + k, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + k),
+			_mm256_loadu_pd(y + k)));
+		_mm256_storeu_pd(y + k + 4, _mm256_fmadd_pd(va,
+			_mm256_loadu_pd(x + k + 4), _mm256_loadu_pd(y + k + 4)));
+	}
+	for(; k + 3 < n; k += 4) {
+		_mm256_storeu_pd(y + k, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + k),
+			_mm256_loadu_pd(y + k)));
+	}
+	for(; k < n; k++) {
+		y[k] += a * x[k];
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void reflect_avx2(double scale, const double *v, double *y, int n) {
+	axpy_avx2(-scale * dot_avx2(v, y, n), v, y, n);
+}
+
+__attribute__((target("avx2,fma")))
+static void rotate_avx2(double c, double s, double *x, double *y, int n) {
+	__m256d vc = _mm256_set1_pd(c), vs = _mm256_set1_pd(s), vx, vy;
+	double t;
+	int k = 0;
+	for(; k + 3 < n; k += 4) {
+		vx = _mm256_loadu_pd(x + k);
+		vy = _mm256_loadu_pd(y + k);
+		_mm256_storeu_pd(x + k, _mm256_fmsub_pd(vc, vx,
+			_mm256_mul_pd(vs, vy)));
+		_mm256_storeu_pd(y + k, _mm256_fmadd_pd(vs, vx,
+			_mm256_mul_pd(vc, vy)));
+	}
+	for(; k < n; k++) {
+		t = c * x[k] - s * y[k];
+		y[k] = s * x[k] + c * y[k];
+		x[k] = t;
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2(int depth, const double *a, const double *b,
+		double *c, int ldc) {
+	__m256d c00 = _mm256_setzero_pd(), c10 = _mm256_setzero_pd();
+	__m256d c01 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+	__m256d c02 = _mm256_setzero_pd(), c12 = _mm256_setzero_pd();
+	__m256d c03 = _mm256_setzero_pd(), c13 = _mm256_setzero_pd();
+	__m256d c04 = _mm256_setzero_pd(), c14 = _mm256_setzero_pd();
+	__m256d c05 = _mm256_setzero_pd(), c15 = _mm256_setzero_pd();
+	__m256d a0, a1, bj;
+	for(int l = 0; l < depth; l++) {
+		a0 = _mm256_loadu_pd(a);
+		a1 = _mm256_loadu_pd(a + 4);
+		bj = _mm256_broadcast_sd(b);
+		c00 = _mm256_fmadd_pd(a0, bj, c00);
+		c10 = _mm256_fmadd_pd(a1, bj, c10);
+		bj = _mm256_broadcast_sd(b + 1);
+		c01 = _mm256_fmadd_pd(a0, bj, c01);
+		c11 = _mm256_fmadd_pd(a1, bj, c11);
+		bj = _mm256_broadcast_sd(b + 2);
+		c02 = _mm256_fmadd_pd(a0, bj, c02);
+		c12 = _mm256_fmadd_pd(a1, bj, c12);
+		bj = _mm256_broadcast_sd(b + 3);
+		c03 = _mm256_fmadd_pd(a0, bj, c03);
+		c13 = _mm256_fmadd_pd(a1, bj, c13);
+		bj = _mm256_broadcast_sd(b + 4);
+		c04 = _mm256_fmadd_pd(a0, bj, c04);
+		c14 = _mm256_fmadd_pd(a1, bj, c14);
+		bj = _mm256_broadcast_sd(b + 5);
+		c05 = _mm256_fmadd_pd(a0, bj, c05);
+		c15 = _mm256_fmadd_pd(a1, bj, c15);
+		a += GEMM_MR;
+		b += GEMM_NR;
+	}
+#define STORE_COLUMN(j, lo, hi) \
+	_mm256_storeu_pd(c + j * ldc, _mm256_add_pd(_mm256_loadu_pd(c + j * ldc), \
+		lo)); \
+	_mm256_storeu_pd(c + j * ldc + 4, _mm256_add_pd( \
+		_mm256_loadu_pd(c + j * ldc + 4), hi));
+	STORE_COLUMN(0, c00, c10);
+	STORE_COLUMN(1, c01, c11);
+	STORE_COLUMN(2, c02, c12);
+	STORE_COLUMN(3, c03, c13);
+	STORE_COLUMN(4, c04, c14);
+	STORE_COLUMN(5, c05, c15);
+#undef STORE_COLUMN
+}
+
+// AVX-512 variants: eight lanes, the tail is handled by masked loads
+
+__attribute__((target("avx512f")))
+static double dot_avx512(const double *x, const double *y, int n) {
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	__mmask8 mask;
+	int k = 0;
+	for(; k + 15 < n; k += 16) {
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + k),
+			_mm512_loadu_pd(y + k), s0);
+		s1 = _mm512_fmadd_pd(_mm512_loadu_pd(x + k + 8),
+			_mm512_loadu_pd(y + k + 8), s1);
+	}
+	for(; k + 7 < n; k += 8) {
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + k),
+			_mm512_loadu_pd(y + k), s0);
+	}
+	if(k < n) {
+		mask = (__mmask8)((1u << (n - k)) - 1);
+		s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x + k),
+			_mm512_maskz_loadu_pd(mask, y + k), s1);
+	}
+	return _mm512_reduce_add_pd(_mm512_add_pd(s0, s1));
+}
+
+__attribute__((target("avx512f")))
+static void axpy_avx512(double a, const double *x, double *y, int n) {
+	__m512d va = _mm512_set1_pd(a);
+	__mmask8 mask;
+	int k = 0;
+	for(; k + 7 < n; k += 8) {
+		_mm512_storeu_pd(y + k, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + k),
+			_mm512_loadu_pd(y + k)));
+	}
+	if(k < n) {
+		mask = (__mmask8)((1u << (n - k)) - 1);
+		_mm512_mask_storeu_pd(y + k, mask, _mm512_fmadd_pd(va,
+			_mm512_maskz_loadu_pd(mask, x + k),
+			_mm512_maskz_loadu_pd(mask, y + k)));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void reflect_avx512(double scale, const double *v, double *y, int n) {
+	axpy_avx512(-scale * dot_avx512(v, y, n), v, y, n);
+}
+
+__attribute__((target("avx512f")))
+static void rotate_avx512(double c, double s, double *x, double *y, int n) {
+	__m512d vc = _mm512_set1_pd(c), vs = _mm512_set1_pd(s), vx, vy;
+	__mmask8 mask;
+	int k = 0;
+	for(; k + 7 < n; k += 8) {
+		vx = _mm512_loadu_pd(x + k);
+		vy = _mm512_loadu_pd(y + k);
+		_mm512_storeu_pd(x + k, _mm512_fmsub_pd(vc, vx,
+			_mm512_mul_pd(vs, vy)));
+		_mm512_storeu_pd(y + k, _mm512_fmadd_pd(vs, vx,
+			_mm512_mul_pd(vc, vy)));
+	}
+	if(k < n) {
+		mask = (__mmask8)((1u << (n - k)) - 1);
+		vx = _mm512_maskz_loadu_pd(mask, x + k);
+		vy = _mm512_maskz_loadu_pd(mask, y + k);
+		_mm512_mask_storeu_pd(x + k, mask, _mm512_fmsub_pd(vc, vx,
+			_mm512_mul_pd(vs, vy)));
+		_mm512_mask_storeu_pd(y + k, mask, _mm512_fmadd_pd(vs, vx,
+			_mm512_mul_pd(vc, vy)));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void gemm_kernel_avx512(int depth, const double *a, const double *b,
+		double *c, int ldc) {
+	__m512d c0 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+	__m512d c2 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+	__m512d c4 = _mm512_setzero_pd(), c5 = _mm512_setzero_pd();
+	__m512d a0;
+	for(int l = 0; l < depth; l++) {
+		a0 = _mm512_loadu_pd(a);
+		c0 = _mm512_fmadd_pd(a0, _mm512_set1_pd(b[0]), c0);
+		c1 = _mm512_fmadd_pd(a0, _mm512_set1_pd(b[1]), c1);
+		c2 = _mm512_fmadd_pd(a0, _mm512_set1_pd(b[2]), c2);
+		c3 = _mm512_fmadd_pd(a0, _mm512_set1_pd(b[3]), c3);
+		c4 = _mm512_fmadd_pd(a0, _mm512_set1_pd(b[4]), c4);
+		c5 = _mm512_fmadd_pd(a0, _mm512_set1_pd(b[5]), c5);
+		a += GEMM_MR;
+		b += GEMM_NR;
+	}
+	_mm512_storeu_pd(c, _mm512_add_pd(_mm512_loadu_pd(c), c0));
+	_mm512_storeu_pd(c + ldc, _mm512_add_pd(_mm512_loadu_pd(c + ldc), c1));
+	_mm512_storeu_pd(c + 2 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 2 * ldc),
+		c2));
+	_mm512_storeu_pd(c + 3 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 3 * ldc),
+		c3));
+	_mm512_storeu_pd(c + 4 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 4 * ldc),
+		c4));
+	_mm512_storeu_pd(c + 5 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 5 * ldc),
+		c5));
+}
+
+#endif
+
+void init_kernels(void) {
+#ifdef X86_KERNELS
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")) {
+		vector_dot = dot_avx512;
+		vector_axpy = axpy_avx512;
+		vector_reflect = reflect_avx512;
+		vector_rotate = rotate_avx512;
+		gemm_kernel = gemm_kernel_avx512;
+	} else if(__builtin_cpu_supports("avx2") &&
+		__builtin_cpu_supports("fma")) {
+		vector_dot = dot_avx2;
+		vector_axpy = axpy_avx2;
+		vector_reflect = reflect_avx2;
+		vector_rotate = rotate_avx2;
+		gemm_kernel = gemm_kernel_avx2;
+	} else if(__builtin_cpu_supports("sse2")) {
+		vector_dot = dot_sse2;
+		vector_axpy = axpy_sse2;
+		vector_reflect = reflect_sse2;
+		vector_rotate = rotate_sse2;
+	}
+#endif
+}
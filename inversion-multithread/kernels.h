@@ -0,0 +1,46 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Vector kernels of the reflector and rotation loops. The pointers are
+// set by init_kernels() to the widest variant supported by the CPU
+
+// Returns x^T y
+extern double (*vector_dot)(const double *x, const double *y, int n);
+
+// y += a * x
+extern void (*vector_axpy)(double a, const double *x, double *y, int n);
+
+// y -= scale * (v^T y) * v
+extern void (*vector_reflect)(double scale, const double *v, double *y,
+	int n);
+
+// (x, y) = (c * x - s * y, s * x + c * y)
+extern void (*vector_rotate)(double c, double s, double *x, double *y,
+	int n);
+
+// Register block of the matrix multiplication micro-kernel
+#define GEMM_MR 8
+#define GEMM_NR 6
+
+// C += A B for the GEMM_MR x GEMM_NR block of C stored by columns with the
+// leading dimension ldc. A is packed by rows of GEMM_MR elements, B is
+// packed by rows of GEMM_NR elements, both are depth long
+extern void (*gemm_kernel)(int depth, const double *a, const double *b,
+	double *c, int ldc);
+
+void init_kernels(void);
@@ -14,42 +14,194 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
+#include "affinity.h"
 #include "common.h"
+#include "distributed.h"
+#include "kernels.h"
 #include "matrixio.h"
 #include "matrixlib.h"
+#include "pool.h"
+#include "tiled.h"
+
 
+// Pages looked up per array for the report of their placement
+#define PAGE_SAMPLES 4096
 
 pthread_mutex_t total_time_mutex = PTHREAD_MUTEX_INITIALIZER;
-long int thread_total_time = 0L;
-int inversion_result = 0;
+double thread_total_time = 0.0;
 
-pthread_mutex_t read_matrix_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t read_matrix_condvar = PTHREAD_COND_INITIALIZER;
+// Names of the phases in the timing report
+const char *phase_names[PHASES_AMOUNT] = {"reflector", "trailing_update",
+	"result_update", "back_substitution", "residual", "wait"};
+
+// Where a worker ran and how fast it read its columns
+struct thread_report {
+	int cpu;
+	double bandwidth;
+};
 
-struct thread_args {
-	int thread_id;
-	int threads_amount;
+// Arguments shared by the workers of a job, every worker fills its own
+// element of results, residual_parts, reports and timings
+struct job_args {
 	double *matrix;
 	double *inverse_matrix;
 	int order;
-	double residual_part;
+	int formula_number;
+	char *filename;
+	int probes;
+	int *results;
+	double *residual_parts;
+	struct tiled_inversion *tiled; // NULL for the bulk-synchronous inversion
+	int depth; // lookahead depth, 0 for the bulk-synchronous inversion
+	int block_size; // distribution of columns, see thread_columns()
+	atomic_int *published;
+	double *diagonal;
+	struct thread_report *reports; // NULL unless the workers are pinned
+	struct thread_timing *timings; // NULL unless the timing is reported
 };
 
-void *thread_execute(void *p_args);
+int load_matrix(struct pool *pool, struct job_args *args);
+
+void print_report(struct job_args *args, int threads_amount);
+
+int write_timing(const char *filename, struct job_args *args,
+	int threads_amount, const char *mode, int runs);
+
+void fill_job(void *p_args, int thread_id, int threads_amount);
+
+void inversion_job(void *p_args, int thread_id, int threads_amount);
+
+void report_job(void *p_args, int thread_id, int threads_amount);
+
+void residual_job(void *p_args, int thread_id, int threads_amount);
 
 int main(int argc, char **argv) {
-	int n, m, k, threads_amount;
-	double *matrix, *inverse, residual_value;
+	int n, m, k, threads_amount, option, probes = 0, barrier = -1, runs = 1;
+	int tile_size = 0, depth = 0, cpus_amount = 0, block_size = 0;
+	int processes = 0;
+	int cpus[MAX_CPUS];
+	char *timing_filename = NULL;
+	double *matrix, *inverse, residual_value = 0.0, lower, upper;
 	int exit_code = 0;
 	char *filename = NULL;
-	struct thread_args *args;
-	pthread_t *threads;
+	struct job_args args;
+	struct tiled_inversion tiled;
+	struct pool *pool;
+	struct timespec begin, end;
+
+	// Usage: a.out [-e probes] [-b spin|block] [-r runs] [-t tile_size |
+	// -l depth | -P processes] [-c block_size] [-a cpus | -s nodes]
+	// [-j timing_file] n m k threads_amount [filename]
+	// -e estimates the residual by random probes in O(n^2) per probe
+	// instead of computing it exactly
+	// -b selects the barrier, by default threads spin unless there are
+	// more of them than online processors
+	// -r inverts the matrix runs times on the same threads and reports the
+	// average time of a run, reading the matrix again included
+	// -t runs the tiled inversion driven by task dependencies instead of
+	// barriers, tile_size is the number of columns of a tile
+	// -l builds every reflector ahead of the update with the previous one,
+	// the columns beyond the next depth ones are updated depth reflectors
+	// at once
+	// -P inverts in processes single-threaded processes that own blocks of
+	// columns and exchange reflectors over sockets, the root loads the whole
+	// matrix only afterwards to check the inverse with threads_amount
+	// threads
+	// -c deals columns to threads by blocks of block_size in turn instead of
+	// cutting them into contiguous parts, it is not accepted with -t and -l
+	// since the tiled inversion hands tiles to whichever thread is free and
+	// the lookahead one always deals single columns
+	// -a pins the workers to the listed CPUs in turn, like -a 0-7,16-23,
+	// -s does the same with all CPUs of the listed nodes. Memory traffic of
+	// every worker and placement of the pages are reported per node
+	// -j writes wall and CPU time of every thread per phase of the inversion
+	// and the residual to timing_file as JSON, - stands for stderr so
+	// that it stays apart from the matrices and the residual on stdout. It
+	// is not accepted with -P, whose processes are not timed by phase
+	while((option = getopt(argc, argv, "e:b:r:t:l:P:c:a:s:j:")) != -1) {
+		switch(option) {
+			case 'b':
+				if(!strcmp(optarg, "spin")) {
+					barrier = BARRIER_SPINNING;
+				} else if(!strcmp(optarg, "block")) {
+					barrier = BARRIER_BLOCKING;
+				} else {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'e':
+				if(sscanf(optarg, "%d", &probes) != 1 || probes < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'r':
+				if(sscanf(optarg, "%d", &runs) != 1 || runs < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 't':
+				if(sscanf(optarg, "%d", &tile_size) != 1 || tile_size < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'l':
+				if(sscanf(optarg, "%d", &depth) != 1 || depth < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'P':
+				if(sscanf(optarg, "%d", &processes) != 1 || processes < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'c':
+				if(sscanf(optarg, "%d", &block_size) != 1 || block_size < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'a':
+				cpus_amount = parse_list(optarg, cpus, MAX_CPUS);
+				if(cpus_amount < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 's':
+				cpus_amount = node_cpus(optarg, cpus, MAX_CPUS);
+				if(cpus_amount < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'j':
+				timing_filename = optarg;
+				break;
+			default:
+				exit_code = 1;
+				goto final;
+		}
+	}
+	argc -= optind - 1;
+	argv += optind - 1;
+
 	if((argc < 5) || (argc > 6)) {
 		exit_code = 1;
 		goto final;
@@ -70,7 +222,10 @@ int main(int argc, char **argv) {
 		exit_code = 1;
 		goto final;
 	}
-	if(k < 0 || k > 4 || n < 1 || m < 1 || threads_amount < 1) {
+	if(k < 0 || k > 4 || n < 1 || m < 1 || threads_amount < 1 ||
+		(tile_size && depth) || (processes && (tile_size || depth)) ||
+		(block_size && (tile_size || depth)) ||
+		(processes && timing_filename)) {
 		exit_code = 1;
 		goto final;
 	}
@@ -79,8 +234,16 @@ int main(int argc, char **argv) {
 			exit_code = 1;
 			goto final;
 		}
-		filename = argv[4];
+		filename = argv[5];
+	}
+
+	init_kernels();
+
+	if(barrier < 0) {
+		barrier = threads_amount <= sysconf(_SC_NPROCESSORS_ONLN) ?
+			BARRIER_SPINNING : BARRIER_BLOCKING;
 	}
+	set_barrier(barrier);
 
 	matrix = (double*)malloc(n * n * sizeof(double));
 	if(!matrix) {
@@ -96,83 +259,213 @@ int main(int argc, char **argv) {
 		goto free_matrix;
 	}
 
-	args = (struct thread_args*)malloc(threads_amount *
-			sizeof(struct thread_args));
-	if(!args) {
+	args.results = (int*)malloc(threads_amount * sizeof(int));
+	if(!args.results) {
 		fprintf(stderr, "ERROR: not enough memory!\n");
 		exit_code = 4;
 		goto free_inverse;
 	}
 
-	threads = (pthread_t*)malloc(threads_amount * sizeof(pthread_t));
-	if(!threads) {
+	args.residual_parts = (double*)malloc(threads_amount * sizeof(double));
+	if(!args.residual_parts) {
 		fprintf(stderr, "ERROR: not enough memory!\n");
 		exit_code = 5;
-		goto free_args;
+		goto free_results;
 	}
 
-	if(read_matrix(matrix, n, k, filename)) {
-		exit_code = 5;
-		goto free_threads;
+	args.timings = NULL;
+	if(timing_filename) {
+		args.timings = (struct thread_timing*)calloc(threads_amount,
+			sizeof(struct thread_timing));
+		if(!args.timings) {
+			fprintf(stderr, "ERROR: not enough memory!\n");
+			exit_code = 5;
+			goto free_residual_parts;
+		}
 	}
 
-	for(int i = 0; i < threads_amount; i++) {
-		args[i].inverse_matrix = inverse;
-		args[i].matrix = matrix;
-		args[i].order = n;
-		args[i].thread_id = i;
-		args[i].threads_amount = threads_amount;
+	args.reports = NULL;
+	if(cpus_amount) {
+		args.reports = (struct thread_report*)malloc(threads_amount *
+			sizeof(struct thread_report));
+		if(!args.reports) {
+			fprintf(stderr, "ERROR: not enough memory!\n");
+			exit_code = 5;
+			goto free_timings;
+		}
 	}
 
-	printf("Original matrix:\n");
-	print_matrix(matrix, n, n, m);
-	printf("\n");
+	args.published = NULL;
+	args.diagonal = NULL;
+	if(depth) {
+		args.published = (atomic_int*)malloc(n * sizeof(atomic_int));
+		args.diagonal = (double*)malloc(n * sizeof(double));
+		if(!args.published || !args.diagonal) {
+			fprintf(stderr, "ERROR: not enough memory!\n");
+			exit_code = 5;
+			goto free_lookahead;
+		}
+	}
 
-	for(int i = 0; i < threads_amount; i++) {
-		if(pthread_create(threads + i, NULL, thread_execute, args + i)) {
-			fprintf(stderr, "ERROR: Cannot create threads!\n");
-			exit_code = 7;
-			goto free_threads;
+	pool = pool_create(threads_amount);
+	if(!pool) {
+		fprintf(stderr, "ERROR: Cannot create threads!\n");
+		exit_code = 7;
+		goto free_lookahead;
+	}
+
+	if(cpus_amount && pool_pin(pool, cpus, cpus_amount)) {
+		fprintf(stderr, "ERROR: Cannot pin threads!\n");
+		exit_code = 7;
+		goto destroy_pool;
+	}
+
+	args.matrix = matrix;
+	args.inverse_matrix = inverse;
+	args.order = n;
+	args.formula_number = k;
+	args.filename = filename;
+	args.probes = probes;
+	args.tiled = tile_size ? &tiled : NULL;
+	args.depth = depth;
+	// The lookahead inversion deals single columns in turn
+	args.block_size = depth ? 1 : block_size;
+
+	// The processes make their own columns, the whole matrix is loaded only
+	// for the check after them
+	if(!processes) {
+		if(load_matrix(pool, &args)) {
+			exit_code = 5;
+			goto destroy_pool;
 		}
+
+		printf("Original matrix:\n");
+		print_matrix(matrix, n, n, m);
+		printf("\n");
 	}
 
-	pthread_mutex_lock(&read_matrix_mutex);
-	pthread_cond_wait(&read_matrix_condvar, &read_matrix_mutex);
-	pthread_mutex_unlock(&read_matrix_mutex);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for(int run = 0; run < runs; run++) {
+		// The inversion destroys the matrix
+		if(run && !processes && load_matrix(pool, &args)) {
+			exit_code = 5;
+			goto destroy_pool;
+		}
 
-	if(inversion_result) {
-		fprintf(stderr, "ERROR: matrix is not invertible\n");
-		exit_code = 6;
-		goto free_threads;
+		if(processes) {
+			switch(distributed_invert(inverse, n, k, filename, processes,
+				block_size ? block_size : DISTRIBUTED_BLOCK_SIZE)) {
+				case 0:
+					continue;
+				case 1:
+					fprintf(stderr, "ERROR: matrix is not invertible\n");
+					exit_code = 6;
+					goto destroy_pool;
+				default:
+					fprintf(stderr, "ERROR: distributed inversion failed\n");
+					exit_code = 7;
+					goto destroy_pool;
+			}
+		}
+
+		if(tile_size && tiled_init(&tiled, matrix, inverse, n, tile_size,
+			threads_amount)) {
+			fprintf(stderr, "ERROR: not enough memory!\n");
+			exit_code = 2;
+			goto destroy_pool;
+		}
+
+		pool_submit(pool, inversion_job, &args);
+		pool_wait(pool);
+
+		if(tile_size) {
+			tiled_free(&tiled);
+		}
+
+		for(int i = 0; i < threads_amount; i++) {
+			if(args.results[i]) {
+				fprintf(stderr, "ERROR: matrix is not invertible\n");
+				exit_code = 6;
+				goto destroy_pool;
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if(load_matrix(pool, &args)) {
+		exit_code = 4;
+		goto destroy_pool;
+	}
+
+	if(processes) {
+		printf("Original matrix:\n");
+		print_matrix(matrix, n, n, m);
+		printf("\n");
 	}
 
 	printf("Inverted matrix:\n");
 	print_matrix(inverse, n, n, m);
 	printf("\n");
 
-	if(read_matrix(matrix, n, k, filename)) {
-		exit_code = 4;
-		goto free_args;
+	pool_submit(pool, residual_job, &args);
+	pool_wait(pool);
+
+	for(int i = 0; i < threads_amount; i++) {
+		residual_value += args.residual_parts[i];
 	}
 
-	pthread_cond_broadcast(&read_matrix_condvar);
+	if(probes) {
+		for(int i = 0; i < threads_amount; i++) {
+			if(args.residual_parts[i] < 0.0) {
+				fprintf(stderr, "ERROR: not enough memory!\n");
+				exit_code = 4;
+				goto destroy_pool;
+			}
+		}
+		residual_value = sqrt(residual_value / probes);
+		residual_bounds(residual_value, probes, &lower, &upper);
+		printf("Residual estimate: %e (%d probes)\n", residual_value, probes);
+		printf("95%% confidence interval: [%e, %e]\n", lower, upper);
+	} else {
+		printf("Residual: %e\n", sqrt(residual_value));
+	}
+	if(runs > 1) {
+		printf("Average run time: %.6lf seconds (%d runs)\n",
+			((end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) /
+			1e9) / runs, runs);
+	}
+	// The threads only check the inverse of the processes
+	if(!processes) {
+		printf("Total threads time: %.2lf seconds\n", thread_total_time);
+		printf("Average threads time: %.2lf seconds\n",
+				thread_total_time / threads_amount);
+	}
 
-	for(int i = 0; i < threads_amount; i++) {
-		pthread_join(threads[i], NULL);
-		fprintf(stderr, "kek\n");
-		residual_value += args[i].residual_part;
+	if(timing_filename && write_timing(timing_filename, &args,
+		threads_amount, tile_size ? "tiled" : depth ? "lookahead" : "bulk",
+		runs)) {
+		exit_code = 8;
+		goto destroy_pool;
 	}
 
-	printf("Residual: %e\n", sqrt(residual_value));
-	printf("Total threads time: %.2lf seconds\n",
-			(double)thread_total_time / 100);
-	printf("Average threads time: %.2lf seconds\n",
-			((double)thread_total_time / threads_amount) / 100);
+	if(cpus_amount) {
+		pool_submit(pool, report_job, &args);
+		pool_wait(pool);
+		print_report(&args, threads_amount);
+	}
 
-	free_threads:
-	free(threads);
-	free_args:
-	free(args);
+	destroy_pool:
+	pool_destroy(pool);
+	free_lookahead:
+	free(args.diagonal);
+	free(args.published);
+	free(args.reports);
+	free_timings:
+	free(args.timings);
+	free_residual_parts:
+	free(args.residual_parts);
+	free_results:
+	free(args.results);
 	free_inverse:
 	free(inverse);
 	free_matrix:
@@ -181,34 +474,185 @@ int main(int argc, char **argv) {
 	return exit_code;
 }
 
-void *thread_execute(void *p_args) {
-	long int start_time, finish_time;
-	int result;
-	struct thread_args *args = (struct thread_args*)p_args;
+int load_matrix(struct pool *pool, struct job_args *args) {
+	pool_submit(pool, fill_job, args);
+	pool_wait(pool);
+
+	// The pages are placed already, the main thread only fills them
+	if(args->filename) {
+		return read_matrix(args->matrix, args->order, args->formula_number,
+			args->filename);
+	}
+
+	return 0;
+}
+
+void print_report(struct job_args *args, int threads_amount) {
+	long matrix_pages[MAX_NODES], inverse_pages[MAX_NODES];
+	double bandwidth[MAX_NODES];
+	int threads[MAX_NODES], node;
+	size_t size = (size_t)args->order * args->order * sizeof(double);
+	int pages_known;
+
+	for(int i = 0; i < MAX_NODES; i++) {
+		bandwidth[i] = 0.0;
+		threads[i] = 0;
+	}
+	for(int i = 0; i < threads_amount; i++) {
+		node = cpu_node(args->reports[i].cpu);
+		bandwidth[node] += args->reports[i].bandwidth;
+		threads[node]++;
+	}
+	pages_known = !count_pages(args->matrix, size, PAGE_SAMPLES,
+		matrix_pages) && !count_pages(args->inverse_matrix, size,
+		PAGE_SAMPLES, inverse_pages);
+
+	printf("Node  Threads  Bandwidth, GB/s  Matrix pages  Inverse pages\n");
+	for(int i = 0; i < MAX_NODES; i++) {
+		if(!threads[i] && (!pages_known || (!matrix_pages[i] &&
+			!inverse_pages[i]))) {
+			continue;
+		}
+		printf("%4d  %7d  %15.2lf", i, threads[i], bandwidth[i]);
+		if(pages_known) {
+			printf("  %12ld  %13ld", matrix_pages[i], inverse_pages[i]);
+		}
+		printf("\n");
+	}
+}
+
+int write_timing(const char *filename, struct job_args *args,
+		int threads_amount, const char *mode, int runs) {
+	FILE *fout = strcmp(filename, "-") ? fopen(filename, "w") : stderr;
+	struct thread_timing *timing;
+	double wall, cpu;
+
+	if(!fout) {
+		perror("ERROR: failed to open file");
+		return 1;
+	}
+
+	fprintf(fout, "{\n  \"order\": %d,\n  \"threads\": %d,\n"
+		"  \"mode\": \"%s\",\n  \"runs\": %d,\n  \"threads_timing\": [\n",
+		args->order, threads_amount, mode, runs);
+	for(int i = 0; i < threads_amount; i++) {
+		timing = args->timings + i;
+		wall = 0.0;
+		cpu = 0.0;
+		fprintf(fout, "    {\"thread\": %d,\n      \"wall\": {", i);
+		for(int phase = 0; phase < PHASES_AMOUNT; phase++) {
+			fprintf(fout, "%s\"%s\": %.9f", phase ? ", " : "",
+				phase_names[phase], timing->wall[phase]);
+			wall += timing->wall[phase];
+		}
+		fprintf(fout, "},\n      \"cpu\": {");
+		for(int phase = 0; phase < PHASES_AMOUNT; phase++) {
+			fprintf(fout, "%s\"%s\": %.9f", phase ? ", " : "",
+				phase_names[phase], timing->cpu[phase]);
+			cpu += timing->cpu[phase];
+		}
+		fprintf(fout, "},\n      \"wall_total\": %.9f, "
+			"\"cpu_total\": %.9f}%s\n", wall, cpu,
+			i + 1 < threads_amount ? "," : "");
+	}
+	fprintf(fout, "  ]\n}\n");
+
+	if(fout != stderr) {
+		fclose(fout);
+	}
+
+	return 0;
+}
+
+void fill_job(void *p_args, int thread_id, int threads_amount) {
+	struct job_args *args = (struct job_args*)p_args;
+	int order = args->order;
+	int start, end;
 
+	// First touch: the columns a thread starts working on are written by it.
+	// The inversion places the pages of the inverse the same way. The tiled
+	// inversion has no owner of a column, the contiguous parts stand for it
+	thread_columns(0, order, args->block_size, thread_id, threads_amount,
+		&start, &end);
+	for(int j = start; j < end; j = next_column(j, args->block_size,
+			threads_amount)) {
+		if(args->filename) {
+			memset(args->matrix + COORD(j, 0, order), 0, order *
+				sizeof(double));
+		} else {
+			fill_columns(args->matrix, order, args->formula_number, j, j + 1);
+		}
+	}
+}
+
+void report_job(void *p_args, int thread_id, int threads_amount) {
+	struct job_args *args = (struct job_args*)p_args;
+	int order = args->order;
+	int start, end, run_end;
+	size_t length;
+	double elements = 0.0, seconds = 0.0;
+
+	args->reports[thread_id].cpu = sched_getcpu();
+
+	// Sweep the own columns of both arrays by runs of adjacent ones
+	thread_columns(0, order, args->block_size, thread_id, threads_amount,
+		&start, &end);
+	for(int j = start; j < end; j = next_column(run_end - 1,
+			args->block_size, threads_amount)) {
+		run_end = args->block_size ? MIN(end, (j / args->block_size + 1) *
+			args->block_size) : end;
+		length = (size_t)(run_end - j) * order;
+		seconds += length / sweep_bandwidth(args->matrix + COORD(j, 0, order),
+			length) + length / sweep_bandwidth(args->inverse_matrix +
+			COORD(j, 0, order), length);
+		elements += 2.0 * length;
+	}
+
+	args->reports[thread_id].bandwidth = seconds > 0.0 ? elements / seconds :
+		0.0;
+}
+
+void inversion_job(void *p_args, int thread_id, int threads_amount) {
+	double start_time, finish_time;
+	struct job_args *args = (struct job_args*)p_args;
+
+	if(args->timings) {
+		timing_start(args->timings + thread_id, PHASE_REFLECTOR);
+	}
 	start_time = get_thread_time();
-	result = invert_matrix(args->matrix, args->inverse_matrix, args->order,
-			args->thread_id, args->threads_amount);
+	if(args->tiled) {
+		args->results[thread_id] = invert_matrix_tiled(args->tiled,
+			thread_id);
+	} else if(args->depth) {
+		args->results[thread_id] = invert_matrix_lookahead(args->matrix,
+			args->inverse_matrix, args->order, args->depth, args->published,
+			args->diagonal, thread_id, threads_amount);
+	} else {
+		args->results[thread_id] = invert_matrix(args->matrix,
+			args->inverse_matrix, args->order, args->block_size, thread_id,
+			threads_amount);
+	}
 	finish_time = get_thread_time();
+	timing_stop();
 
 	pthread_mutex_lock(&total_time_mutex);
 	thread_total_time += (finish_time - start_time);
-	inversion_result = inversion_result | result;
-
-	if(args->thread_id == 0) {
-		pthread_cond_signal(&read_matrix_condvar);
-	}
 	pthread_mutex_unlock(&total_time_mutex);
+}
 
-	if(result) {
-		return NULL;
-	}
-	
-	pthread_mutex_lock(&read_matrix_mutex);
-	pthread_cond_wait(&read_matrix_condvar, &read_matrix_mutex);
-	pthread_mutex_unlock(&read_matrix_mutex);
-	args->residual_part = residual(args->matrix, args->inverse_matrix,
-			args->order, args->thread_id, args->threads_amount);
+void residual_job(void *p_args, int thread_id, int threads_amount) {
+	struct job_args *args = (struct job_args*)p_args;
 
-	return NULL;
+	if(args->timings) {
+		timing_start(args->timings + thread_id, PHASE_RESIDUAL);
+	}
+	if(args->probes) {
+		args->residual_parts[thread_id] = estimate_residual(args->matrix,
+			args->inverse_matrix, args->order, args->probes, thread_id,
+			threads_amount);
+	} else {
+		args->residual_parts[thread_id] = residual(args->matrix,
+			args->inverse_matrix, args->order, thread_id, threads_amount);
+	}
+	timing_stop();
 }
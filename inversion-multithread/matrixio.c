@@ -15,6 +15,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "common.h"
 #include "matrixio.h"
@@ -46,13 +47,89 @@ int read_matrix(double *matrix, int order, int formula_number,
 		}
 		fclose(fin);
 	} else {
-		for(int i = 0; i < order; i++) {
-			for(int j = 0; j < order; j++) {
-				matrix[COORD(j, i, order)] = f(order, formula_number, i + 1,
-					j + 1);
+		fill_columns(matrix, order, formula_number, 0, order);
+	}
+	return 0;
+}
+
+void fill_columns(double *matrix, int order, int formula_number, int start,
+		int end) {
+	for(int j = start; j < end; j++) {
+		fill_column(matrix + COORD(j, 0, order), order, formula_number, j);
+	}
+}
+
+void fill_column(double *column, int order, int formula_number, int j) {
+	// The formula is chosen once and split at the diagonal, so the loops
+	// over a column have no branches and are vectorized. With 1-based i and
+	// j the elements are n - max(i, j) + 1, max(i, j), |i - j| and
+	// 1 / (i + j - 1) for the formulas 1 to 4
+	switch(formula_number) {
+		case 1:
+			for(int i = 0; i <= j; i++) {
+				column[i] = order - j;
+			}
+			for(int i = j + 1; i < order; i++) {
+				column[i] = order - i;
+			}
+			break;
+		case 2:
+			for(int i = 0; i <= j; i++) {
+				column[i] = j + 1;
+			}
+			for(int i = j + 1; i < order; i++) {
+				column[i] = i + 1;
+			}
+			break;
+		case 3:
+			for(int i = 0; i <= j; i++) {
+				column[i] = j - i;
+			}
+			for(int i = j + 1; i < order; i++) {
+				column[i] = i - j;
+			}
+			break;
+		case 4:
+			for(int i = 0; i < order; i++) {
+				column[i] = 1.0 / (double)(i + j + 1);
+			}
+			break;
+		default:
+			memset(column, 0, order * sizeof(double));
+	}
+}
+
+int read_columns(double *columns, int order, char *filename,
+		const int *local_index) {
+	FILE *fin = fopen(filename, "r");
+	double value;
+	int result;
+
+	if(!fin) {
+		perror("ERROR: failed to open file");
+		return 1;
+	}
+	for(int i = 0; i < order; i++) {
+		for(int j = 0; j < order; j++) {
+			result = fscanf(fin, "%lf", &value);
+			if(result != 1) {
+				if(result == EOF) {
+					fprintf(stderr,
+						"ERROR: unexcepted EOF while reading matrix\n");
+				} else {
+					fprintf(stderr,
+						"ERROR: got invalid data while reading matrix\n");
+				}
+				fclose(fin);
+				return 1;
+			}
+			if(local_index[j] >= 0) {
+				columns[COORD(local_index[j], i, order)] = value;
 			}
 		}
 	}
+	fclose(fin);
+
 	return 0;
 }
 
@@ -19,4 +19,16 @@
 int read_matrix(double *matrix, int order, int formula_number,
 	char *filename);
 
+// Generates the columns start..end - 1 of the matrix by the formula
+void fill_columns(double *matrix, int order, int formula_number, int start,
+	int end);
+
+// Generates column j of the matrix by the formula
+void fill_column(double *column, int order, int formula_number, int j);
+
+// Reads only the columns j with local_index[j] >= 0, column j is stored as
+// the local_index[j]-th one of columns
+int read_columns(double *columns, int order, char *filename,
+	const int *local_index);
+
 void print_matrix(double *matrix, int height, int width, int max_cols_rows);
\ No newline at end of file
@@ -15,35 +15,52 @@
  */
 
 #include <math.h>
+#include <sched.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <assert.h>
 
 #include "matrixlib.h"
 #include "common.h"
+#include "kernels.h"
+#include "gemm.h"
 
-int invert_matrix(double *matrix, double *result, int order, int thread_id,
-					int threads_amount) {
-	double s, norm1, norm2, tmp;
+// Width of the panel of A * A^{-1} formed at once by residual()
+#define RESIDUAL_COLUMNS 256
+
+// States of a reflector in invert_matrix_lookahead()
+#define REFLECTOR_PENDING 0
+#define REFLECTOR_READY 1
+#define REFLECTOR_SINGULAR 2
+
+// Checks of a reflector state before the waiting thread yields
+#define LOOKAHEAD_SPINS 1024
+
+int invert_matrix(double *matrix, double *result, int order, int block_size,
+					int thread_id, int threads_amount) {
+	double s, norm1, norm2;
 	int work_range_start, work_range_end;
 
-	synchronize(threads_amount);
+	// Generate the identity matrix: every thread writes the columns it
+	// updates below, so their pages are placed next to it
 
-	// Generate the identity matrix
-	
-	if(thread_id == 0) {
-		memset(result, 0, (size_t)order * order * sizeof(double));
-		for(int i = 0; i < order; i++)
-			result[COORD(i, i, order)] = 1.0;
+	timing_phase(PHASE_RESULT);
+	thread_columns(0, order, block_size, thread_id, threads_amount,
+		&work_range_start, &work_range_end);
+
+	for(int j = work_range_start; j < work_range_end;
+			j = next_column(j, block_size, threads_amount)) {
+		memset(result + COORD(j, 0, order), 0, order * sizeof(double));
+		result[COORD(j, j, order)] = 1.0;
 	}
-	
+
 	synchronize(threads_amount);
 	// Cast the matrix to upper triangular type
 	for(int i = 0; i < order; i++) {
-		s = 0.0;
-		for(int j = i + 1; j < order; j++) {
-			s += SQUARE(matrix[COORD(i, j, order)]);
-		}
+		timing_phase(PHASE_REFLECTOR);
+		s = vector_dot(matrix + COORD(i, i + 1, order),
+			matrix + COORD(i, i + 1, order), order - i - 1);
 
 		norm1 = sqrt(SQUARE(matrix[COORD(i, i, order)]) + s);
 
@@ -70,36 +87,24 @@ int invert_matrix(double *matrix, double *result, int order, int thread_id,
 		// Vector of reflection is ready, now we need to operate on matrices
 		synchronize(threads_amount);
 
-		work_range_start = ((order - i - 1) * thread_id) / threads_amount +
-			i + 1;
-		work_range_end = ((order - i - 1) * (thread_id + 1)) / threads_amount +
-		   	i + 1;
-
-		for(int j = work_range_start; j < work_range_end; j++) {
-			s = 0.0;
-			for(int k = i; k < order; k++) {
-				s += matrix[COORD(i, k, order)] * matrix[COORD(j, k, order)];
-			}
+		timing_phase(PHASE_TRAILING);
+		thread_columns(i + 1, order, block_size, thread_id, threads_amount,
+			&work_range_start, &work_range_end);
 
-			s *= 2.0;
-			for(int k = i; k < order; k++) {
-				matrix[COORD(j, k, order)] -= s * matrix[COORD(i, k, order)];
-			}
+		for(int j = work_range_start; j < work_range_end;
+				j = next_column(j, block_size, threads_amount)) {
+			vector_reflect(2.0, matrix + COORD(i, i, order),
+				matrix + COORD(j, i, order), order - i);
 		}
 
-		work_range_start = (order * thread_id) / threads_amount;
-		work_range_end = (order * (thread_id + 1)) / threads_amount;
-
-		for(int j = work_range_start; j < work_range_end; j++) {
-			s = 0.0;
-			for(int k = i; k < order; k++) {
-				s += matrix[COORD(i, k, order)] * result[COORD(j, k, order)];
-			}
+		timing_phase(PHASE_RESULT);
+		thread_columns(0, order, block_size, thread_id, threads_amount,
+			&work_range_start, &work_range_end);
 
-			s *= 2.0;
-			for(int k = i; k < order; k++) {
-				result[COORD(j, k, order)] -= s * matrix[COORD(i, k, order)];
-			}
+		for(int j = work_range_start; j < work_range_end;
+				j = next_column(j, block_size, threads_amount)) {
+			vector_reflect(2.0, matrix + COORD(i, i, order),
+				result + COORD(j, i, order), order - i);
 		}
 
 		synchronize(threads_amount);
@@ -110,38 +115,171 @@ int invert_matrix(double *matrix, double *result, int order, int thread_id,
 		}
 	}
 
+	// The last diagonal element is set after the last barrier
+	synchronize(threads_amount);
+
 	// Back substitution of Gaussian method
 	// We know that the matrix is inversible at the moment
 	// Note: no action is required on matrix
+	// Columns of result are independent here: every thread solves for its
+	// own ones, so no barriers are needed
 
-	for(int i = order - 1; i >= 0; i--) {
-		// Divide i-th row of result by matrix[i, i]
+	timing_phase(PHASE_BACK);
+	thread_columns(0, order, block_size, thread_id, threads_amount,
+		&work_range_start, &work_range_end);
 
-		s = 1 / matrix[COORD(i, i, order)];
-		if(thread_id == 1) {
-			for(int j = 0; j < order; j++) {
-				result[COORD(j, i, order)] *= s;
-			}
+	for(int j = work_range_start; j < work_range_end;
+			j = next_column(j, block_size, threads_amount)) {
+		for(int i = order - 1; i >= 0; i--) {
+			// Divide i-th element by matrix[i, i] and substract the i-th
+			// column of matrix multiplied by it from elements 0, ..., i - 1
+			result[COORD(j, i, order)] /= matrix[COORD(i, i, order)];
+			vector_axpy(-result[COORD(j, i, order)], matrix + COORD(i, 0,
+				order), result + COORD(j, 0, order), i);
 		}
-		synchronize(threads_amount);
+	}
 
-		// Substract i-th row of result multiplied by matrix[j, i] from
-		// j-th row of result for j = 0, ..., i - 1
-		// But do it in the column-first order
+	// And... here we go
+	return 0;
+}
+
+int make_reflector(double *column, int length, double *diagonal) {
+	double s, norm1, norm2;
 
-		work_range_start = (order * thread_id) / threads_amount;
-		work_range_end = (order * (thread_id + 1)) / threads_amount;
+	s = vector_dot(column + 1, column + 1, length - 1);
+
+	norm1 = sqrt(SQUARE(column[0]) + s);
+
+	if(norm1 < EPS) {
+		return 1; // non-invertible matrix
+	}
 
-		for(int j = work_range_start; j < work_range_end; j++) {
-			tmp = result[COORD(j, i, order)];
-			for(int k = 0; k < i; k++) {
-				result[COORD(j, k, order)] -= tmp * matrix[COORD(i, k, order)];
+	if(s < EPS) {
+		*diagonal = column[0];
+		memset(column, 0, length * sizeof(double));
+		return 0;
+	}
+
+	column[0] -= norm1;
+	norm2 = sqrt(SQUARE(column[0]) + s);
+
+	norm2 = 1.0 / norm2;
+	for(int j = 0; j < length; j++) {
+		column[j] *= norm2;
+	}
+	*diagonal = norm1;
+
+	return 0;
+}
+
+static int wait_reflector(atomic_int *published) {
+	int state, phase = timing_phase(PHASE_WAIT);
+
+	for(int spins = 0; !(state = atomic_load_explicit(published,
+			memory_order_acquire)); spins++) {
+		if(spins >= LOOKAHEAD_SPINS) {
+			sched_yield();
+		}
+	}
+	timing_phase(phase);
+
+	return state;
+}
+
+// Applies the reflectors first..last to the column of target
+static void apply_reflectors(double *matrix, double *target, int order,
+		int first, int last, int column) {
+	for(int i = first; i <= last; i++) {
+		vector_reflect(2.0, matrix + COORD(i, i, order),
+			target + COORD(column, i, order), order - i);
+	}
+}
+
+int invert_matrix_lookahead(double *matrix, double *result, int order,
+		int depth, atomic_int *published, double *diagonal, int thread_id,
+		int threads_amount) {
+	// Reflectors from deferred on are not applied yet to the columns
+	// beyond the window i + 1..i + depth and to result
+	int deferred = 0;
+	int window_end;
+
+	if(thread_id == 0) {
+		for(int i = 0; i < order; i++) {
+			atomic_init(published + i, REFLECTOR_PENDING);
+		}
+	}
+
+	// Generate the own columns of the identity matrix
+	timing_phase(PHASE_RESULT);
+	for(int j = thread_id; j < order; j += threads_amount) {
+		memset(result + COORD(j, 0, order), 0, order * sizeof(double));
+		result[COORD(j, j, order)] = 1.0;
+	}
+
+	synchronize(threads_amount);
+
+	if(thread_id == 0) {
+		timing_phase(PHASE_REFLECTOR);
+		atomic_store_explicit(published, make_reflector(matrix, order,
+			diagonal) ? REFLECTOR_SINGULAR : REFLECTOR_READY,
+			memory_order_release);
+	}
+
+	for(int i = 0; i < order; i++) {
+		if(wait_reflector(published + i) == REFLECTOR_SINGULAR) {
+			return 1; // non-invertible matrix
+		}
+
+		// The column entering the window catches up with the deferred
+		// reflectors, then the window gets the current one
+		timing_phase(PHASE_TRAILING);
+		window_end = MIN(i + depth, order - 1);
+		if(i + depth < order && (i + depth) % threads_amount == thread_id) {
+			apply_reflectors(matrix, matrix, order, deferred, i - 1,
+				i + depth);
+		}
+		for(int j = i + 1; j <= window_end; j++) {
+			if(j % threads_amount == thread_id) {
+				apply_reflectors(matrix, matrix, order, i, i, j);
 			}
 		}
-		synchronize(threads_amount);
+
+		// Column i + 1 is complete now: publish its reflector before doing
+		// the rest of the work with reflector i
+		if(i + 1 < order && (i + 1) % threads_amount == thread_id) {
+			timing_phase(PHASE_REFLECTOR);
+			atomic_store_explicit(published + i + 1, make_reflector(matrix +
+				COORD(i + 1, i + 1, order), order - i - 1, diagonal + i + 1) ?
+				REFLECTOR_SINGULAR : REFLECTOR_READY, memory_order_release);
+		}
+
+		if(i - deferred + 1 < depth && i < order - 1) {
+			continue;
+		}
+		timing_phase(PHASE_TRAILING);
+		for(int j = window_end + 1; j < order; j++) {
+			if(j % threads_amount == thread_id) {
+				apply_reflectors(matrix, matrix, order, deferred, i, j);
+			}
+		}
+		timing_phase(PHASE_RESULT);
+		for(int j = thread_id; j < order; j += threads_amount) {
+			apply_reflectors(matrix, result, order, deferred, i, j);
+		}
+		deferred = i + 1;
+	}
+
+	// Back substitution of Gaussian method: every thread solves for its own
+	// columns of result, all of R is published by now
+	timing_phase(PHASE_BACK);
+	for(int j = thread_id; j < order; j += threads_amount) {
+		for(int i = order - 1; i >= 0; i--) {
+			result[COORD(j, i, order)] /= diagonal[i];
+			vector_axpy(-result[COORD(j, i, order)], matrix + COORD(i, 0,
+				order), result + COORD(j, 0, order), i);
+		}
 	}
 
-	// And... here we go
 	return 0;
 }
 
@@ -149,9 +287,38 @@ double residual(double *matrix, double *result, int order, int thread_id,
 				int threads_amount) {
 	double product_elem = 0.0;
 	double norm_square = 0.0;
+	double *product;
 	int work_range_start = (order * thread_id) / threads_amount;
 	int work_range_end = (order * (thread_id + 1)) / threads_amount;
+	int width;
+
+	// Every thread forms its own columns of A * A^{-1} by panels with the
+	// packed multiplication, only the current panel is kept in memory
+	product = (double*)malloc((size_t)order * RESIDUAL_COLUMNS *
+		sizeof(double));
+	if(product) {
+		for(int j = work_range_start; j < work_range_end; j += width) {
+			width = MIN(RESIDUAL_COLUMNS, work_range_end - j);
+			if(multiply_matrices(matrix, order, result + COORD(j, 0, order),
+				order, product, order, order, width, order, 0, 1)) {
+				break;
+			}
+			for(int jj = 0; jj < width; jj++) {
+				product[COORD(jj, j + jj, order)] -= 1.0;
+				for(int i = 0; i < order; i++) {
+					norm_square += SQUARE(product[COORD(jj, i, order)]);
+				}
+			}
+			if(j + width == work_range_end) {
+				free(product);
+				return norm_square;
+			}
+		}
+		free(product);
+		norm_square = 0.0;
+	}
 
+	// Not enough memory for the packed multiplication
 	for(int i = work_range_start; i < work_range_end; i++) {
 		for(int j = 0; j < order; j++) {
 			product_elem = 0.0;
@@ -166,3 +333,70 @@ double residual(double *matrix, double *result, int order, int thread_id,
 
 	return norm_square;
 }
+
+// Gaussian sample by Box-Muller from the splitmix64 sequence in state
+static double gaussian(unsigned long long *state) {
+	double u1, u2;
+	unsigned long long x;
+
+	x = (*state += 0x9e3779b97f4a7c15ULL);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	u1 = ((double)((x ^ (x >> 31)) >> 11) + 0.5) / 9007199254740992.0;
+
+	x = (*state += 0x9e3779b97f4a7c15ULL);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	u2 = ((double)((x ^ (x >> 31)) >> 11) + 0.5) / 9007199254740992.0;
+
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+double estimate_residual(double *matrix, double *result, int order,
+		int probes, int thread_id, int threads_amount) {
+	double norm_square = 0.0;
+	double *g, *y;
+	unsigned long long state;
+
+	g = (double*)malloc(2 * (size_t)order * sizeof(double));
+	if(!g) {
+		return -1.0;
+	}
+	y = g + order;
+
+	// E |(A X - I) g|^2 = |A X - I|_F^2 for g ~ N(0, I). Probes are dealt
+	// to threads cyclically and seeded by their number, so the estimate
+	// does not depend on threads_amount
+	for(int p = thread_id; p < probes; p += threads_amount) {
+		state = (unsigned long long)p;
+		for(int i = 0; i < order; i++) {
+			g[i] = gaussian(&state);
+			y[i] = 0.0;
+		}
+
+		for(int k = 0; k < order; k++) {
+			vector_axpy(g[k], result + COORD(k, 0, order), y, order);
+		}
+		for(int k = 0; k < order; k++) {
+			vector_axpy(-y[k], matrix + COORD(k, 0, order), g, order);
+		}
+
+		norm_square += vector_dot(g, g, order);
+	}
+
+	free(g);
+
+	return norm_square;
+}
+
+void residual_bounds(double estimate, int probes, double *lower,
+		double *upper) {
+	// Laurent-Massart tail bounds for the sum of probes * order weighted
+	// chi-square variables: each side fails with probability at most
+	// 2.5% whatever the singular values of A X - I are
+	double x = log(40.0) / probes;
+
+	*lower = estimate / sqrt(1.0 + 2.0 * sqrt(x) + 2.0 * x);
+	*upper = 2.0 * sqrt(x) < 1.0 ? estimate / sqrt(1.0 - 2.0 * sqrt(x)) :
+		INFINITY;
+}
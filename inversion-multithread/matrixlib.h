@@ -17,9 +17,38 @@
 #pragma once
 
 #include <pthread.h>
+#include <stdatomic.h>
 
-int invert_matrix(double *matrix, double *result, int order, int thread_id,
+// Columns of every parallel loop are split between threads by
+// thread_columns() with block_size
+int invert_matrix(double *matrix, double *result, int order, int block_size,
+		int thread_id, int threads_amount);
+
+// Inversion with lookahead. Columns are dealt to threads cyclically, the
+// owner of a column builds its reflector as soon as the column has got the
+// previous ones and publishes it in published[], then goes on applying the
+// previous reflector. Columns beyond the next depth ones get reflectors in
+// batches of depth. Threads wait only for the reflectors they need, the
+// sole barrier is at the start. published and diagonal are order elements
+// long and shared by all threads
+int invert_matrix_lookahead(double *matrix, double *result, int order,
+		int depth, atomic_int *published, double *diagonal, int thread_id,
 		int threads_amount);
 
+// Turns column[0..length) into the unit vector v such that the reflection
+// I - 2 v v^T maps the column to (*diagonal, 0, ..., 0). A column that is
+// already zero below the first element becomes the zero vector, which
+// reflects nothing. Returns 1 if the column is zero
+int make_reflector(double *column, int length, double *diagonal);
+
 double residual(double *matrix, double *result, int order, int thread_id,
 		int threads_amount);
+
+// Part of thread_id of the sum of |(A A^{-1} - I) g|^2 over probes Gaussian
+// vectors g, O(n^2) per probe. Returns -1 if there is not enough memory
+double estimate_residual(double *matrix, double *result, int order,
+		int probes, int thread_id, int threads_amount);
+
+// 95% confidence interval of |A A^{-1} - I|_F given its estimate
+void residual_bounds(double estimate, int probes, double *lower,
+		double *upper);
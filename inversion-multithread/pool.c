@@ -0,0 +1,166 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "pool.h"
+
+static void *pool_execute(void *p_worker) {
+	struct pool_worker *worker = (struct pool_worker*)p_worker;
+	struct pool *pool = worker->pool;
+	long int jobs_done = 0;
+	pool_job job;
+	void *data;
+
+	for(;;) {
+		// The predicate is rechecked under the mutex, so a job submitted
+		// before the worker got here is not lost
+		pthread_mutex_lock(&pool->mutex);
+		while(pool->jobs_submitted == jobs_done && !pool->stop) {
+			pthread_cond_wait(&pool->job_condvar, &pool->mutex);
+		}
+		if(pool->jobs_submitted == jobs_done) {
+			pthread_mutex_unlock(&pool->mutex);
+			return NULL;
+		}
+		jobs_done = pool->jobs_submitted;
+		job = pool->job;
+		data = pool->data;
+		pthread_mutex_unlock(&pool->mutex);
+
+		job(data, worker->thread_id, pool->threads_amount);
+
+		pthread_mutex_lock(&pool->mutex);
+		if(--pool->workers_running == 0) {
+			pthread_cond_broadcast(&pool->done_condvar);
+		}
+		pthread_mutex_unlock(&pool->mutex);
+	}
+}
+
+struct pool *pool_create(int threads_amount) {
+	struct pool *pool;
+	int created;
+
+	pool = (struct pool*)malloc(sizeof(struct pool));
+	if(!pool) {
+		return NULL;
+	}
+	pool->threads = (pthread_t*)malloc(threads_amount * sizeof(pthread_t));
+	pool->workers = (struct pool_worker*)malloc(threads_amount *
+		sizeof(struct pool_worker));
+	if(!pool->threads || !pool->workers) {
+		goto free_pool;
+	}
+
+	pool->threads_amount = threads_amount;
+	pool->job = NULL;
+	pool->data = NULL;
+	pool->jobs_submitted = 0;
+	pool->workers_running = 0;
+	pool->stop = 0;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->job_condvar, NULL);
+	pthread_cond_init(&pool->done_condvar, NULL);
+
+	for(created = 0; created < threads_amount; created++) {
+		pool->workers[created].pool = pool;
+		pool->workers[created].thread_id = created;
+		if(pthread_create(pool->threads + created, NULL, pool_execute,
+			pool->workers + created)) {
+			break;
+		}
+	}
+	if(created == threads_amount) {
+		return pool;
+	}
+
+	// Stop the workers that have started
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->job_condvar);
+	pthread_mutex_unlock(&pool->mutex);
+	for(int i = 0; i < created; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->done_condvar);
+	pthread_cond_destroy(&pool->job_condvar);
+	pthread_mutex_destroy(&pool->mutex);
+
+	free_pool:
+	free(pool->workers);
+	free(pool->threads);
+	free(pool);
+	return NULL;
+}
+
+void pool_submit(struct pool *pool, pool_job job, void *data) {
+	pthread_mutex_lock(&pool->mutex);
+	while(pool->workers_running) {
+		pthread_cond_wait(&pool->done_condvar, &pool->mutex);
+	}
+	pool->job = job;
+	pool->data = data;
+	pool->workers_running = pool->threads_amount;
+	pool->jobs_submitted++;
+	pthread_cond_broadcast(&pool->job_condvar);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+int pool_pin(struct pool *pool, const int *cpus, int cpus_amount) {
+	cpu_set_t set;
+
+	for(int i = 0; i < pool->threads_amount; i++) {
+		CPU_ZERO(&set);
+		CPU_SET(cpus[i % cpus_amount], &set);
+		if(pthread_setaffinity_np(pool->threads[i], sizeof(set), &set)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void pool_wait(struct pool *pool) {
+	pthread_mutex_lock(&pool->mutex);
+	while(pool->workers_running) {
+		pthread_cond_wait(&pool->done_condvar, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void pool_destroy(struct pool *pool) {
+	pool_wait(pool);
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->job_condvar);
+	pthread_mutex_unlock(&pool->mutex);
+	for(int i = 0; i < pool->threads_amount; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->done_condvar);
+	pthread_cond_destroy(&pool->job_condvar);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->workers);
+	free(pool->threads);
+	free(pool);
+}
@@ -0,0 +1,59 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+// Job of a pool: every worker calls it once with its own thread_id, so a
+// job splits the work by thread_id and may call synchronize(threads_amount)
+typedef void (*pool_job)(void *data, int thread_id, int threads_amount);
+
+struct pool_worker {
+	struct pool *pool;
+	int thread_id;
+};
+
+// Workers created once and parked between jobs
+struct pool {
+	pthread_t *threads;
+	struct pool_worker *workers;
+	int threads_amount;
+	pthread_mutex_t mutex;
+	pthread_cond_t job_condvar; // a job is submitted or the pool is stopped
+	pthread_cond_t done_condvar; // the last worker finished the job
+	pool_job job;
+	void *data;
+	long int jobs_submitted;
+	int workers_running;
+	int stop;
+};
+
+// Returns NULL if threads or memory cannot be allocated
+struct pool *pool_create(int threads_amount);
+
+// Runs job(data, thread_id, threads_amount) on every worker, waits for the
+// previous job first
+void pool_submit(struct pool *pool, pool_job job, void *data);
+
+// Pins worker i to cpus[i % cpus_amount], returns 1 on failure
+int pool_pin(struct pool *pool, const int *cpus, int cpus_amount);
+
+// Waits until every worker has returned from the last submitted job
+void pool_wait(struct pool *pool);
+
+// Waits for the last job and joins the workers
+void pool_destroy(struct pool *pool);
@@ -0,0 +1,289 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "kernels.h"
+#include "matrixlib.h"
+#include "tiled.h"
+
+// Tasks are indexed as panels, then updates and applies by (q, j) on the
+// full tiles x tiles grid, then solves
+#define PANEL_TASK(inversion, q) (q)
+#define UPDATE_TASK(inversion, q, j) ((inversion)->tiles + \
+	COORD(q, j, (inversion)->tiles))
+#define APPLY_TASK(inversion, q, j) ((inversion)->tiles * \
+	((inversion)->tiles + 1) + COORD(q, j, (inversion)->tiles))
+#define SOLVE_TASK(inversion, j) ((inversion)->tiles * \
+	(2 * (inversion)->tiles + 1) + (j))
+
+static void set_task(struct tiled_inversion *inversion, int task, int type,
+		int q, int j, int pending) {
+	inversion->tasks[task].type = type;
+	inversion->tasks[task].q = q;
+	inversion->tasks[task].j = j;
+	atomic_init(&inversion->tasks[task].pending, pending);
+}
+
+int tiled_init(struct tiled_inversion *inversion, double *matrix,
+		double *result, int order, int tile_size, int threads_amount) {
+	int tiles = (order + tile_size - 1) / tile_size;
+	int tasks_amount = 2 * tiles * (tiles + 1);
+	int created;
+
+	inversion->matrix = matrix;
+	inversion->result = result;
+	inversion->order = order;
+	inversion->tile_size = tile_size;
+	inversion->tiles = tiles;
+	inversion->threads_amount = threads_amount;
+
+	inversion->diagonal = (double*)malloc(order * sizeof(double));
+	inversion->tasks = (struct task*)malloc(tasks_amount *
+		sizeof(struct task));
+	inversion->deques = (struct task_deque*)malloc(threads_amount *
+		sizeof(struct task_deque));
+	if(!inversion->diagonal || !inversion->tasks || !inversion->deques) {
+		goto free_arrays;
+	}
+
+	// Every task is pushed once, so a deque never holds more of them
+	for(created = 0; created < threads_amount; created++) {
+		inversion->deques[created].tasks = (int*)malloc(tasks_amount *
+			sizeof(int));
+		if(!inversion->deques[created].tasks) {
+			break;
+		}
+		pthread_mutex_init(&inversion->deques[created].mutex, NULL);
+		inversion->deques[created].top = 0;
+		inversion->deques[created].bottom = 0;
+	}
+	if(created < threads_amount) {
+		for(int i = 0; i < created; i++) {
+			pthread_mutex_destroy(&inversion->deques[i].mutex);
+			free(inversion->deques[i].tasks);
+		}
+		goto free_arrays;
+	}
+
+	for(int q = 0; q < tiles; q++) {
+		set_task(inversion, PANEL_TASK(inversion, q), TASK_PANEL, q, q,
+			q > 0);
+		for(int j = 0; j < tiles; j++) {
+			set_task(inversion, UPDATE_TASK(inversion, q, j), TASK_UPDATE, q,
+				j, 1 + (q > 0));
+			set_task(inversion, APPLY_TASK(inversion, q, j), TASK_APPLY, q,
+				j, 1 + (q > 0));
+		}
+		set_task(inversion, SOLVE_TASK(inversion, q), TASK_SOLVE, q, q, 1);
+	}
+	atomic_init(&inversion->tasks_left, tiles + tiles * (tiles - 1) / 2 +
+		tiles * tiles + tiles);
+	atomic_init(&inversion->singular, 0);
+
+	inversion->deques[0].tasks[inversion->deques[0].bottom++] =
+		PANEL_TASK(inversion, 0);
+
+	return 0;
+
+	free_arrays:
+	free(inversion->deques);
+	free(inversion->tasks);
+	free(inversion->diagonal);
+	return 2;
+}
+
+void tiled_free(struct tiled_inversion *inversion) {
+	for(int i = 0; i < inversion->threads_amount; i++) {
+		pthread_mutex_destroy(&inversion->deques[i].mutex);
+		free(inversion->deques[i].tasks);
+	}
+	free(inversion->deques);
+	free(inversion->tasks);
+	free(inversion->diagonal);
+}
+
+static void push_task(struct task_deque *deque, int task) {
+	pthread_mutex_lock(&deque->mutex);
+	deque->tasks[deque->bottom++] = task;
+	pthread_mutex_unlock(&deque->mutex);
+}
+
+// Newest task of the own deque or the oldest one of another, -1 if empty
+static int take_task(struct task_deque *deque, int own) {
+	int task = -1;
+
+	pthread_mutex_lock(&deque->mutex);
+	if(deque->top < deque->bottom) {
+		task = own ? deque->tasks[--deque->bottom] :
+			deque->tasks[deque->top++];
+	}
+	if(deque->top == deque->bottom) {
+		deque->top = 0;
+		deque->bottom = 0;
+	}
+	pthread_mutex_unlock(&deque->mutex);
+
+	return task;
+}
+
+static void release_task(struct tiled_inversion *inversion, int task,
+		int thread_id) {
+	if(atomic_fetch_sub(&inversion->tasks[task].pending, 1) == 1) {
+		push_task(inversion->deques + thread_id, task);
+	}
+}
+
+static void panel(struct tiled_inversion *inversion, int q) {
+	double *matrix = inversion->matrix;
+	int order = inversion->order;
+	int start = q * inversion->tile_size;
+	int end = MIN(start + inversion->tile_size, order);
+
+	for(int i = start; i < end; i++) {
+		if(make_reflector(matrix + COORD(i, i, order), order - i,
+			inversion->diagonal + i)) {
+			atomic_store(&inversion->singular, 1);
+			return;
+		}
+
+		for(int j = i + 1; j < end; j++) {
+			vector_reflect(2.0, matrix + COORD(i, i, order),
+				matrix + COORD(j, i, order), order - i);
+		}
+	}
+}
+
+// Applies the reflectors of tile q to tile j of target
+static void reflect_tile(struct tiled_inversion *inversion, double *target,
+		int q, int j) {
+	double *matrix = inversion->matrix;
+	int order = inversion->order;
+	int start = q * inversion->tile_size;
+	int end = MIN(start + inversion->tile_size, order);
+
+	for(int c = j * inversion->tile_size;
+			c < MIN((j + 1) * inversion->tile_size, order); c++) {
+		for(int i = start; i < end; i++) {
+			vector_reflect(2.0, matrix + COORD(i, i, order),
+				target + COORD(c, i, order), order - i);
+		}
+	}
+}
+
+static void solve(struct tiled_inversion *inversion, int j) {
+	double *matrix = inversion->matrix;
+	double *result = inversion->result;
+	int order = inversion->order;
+
+	for(int c = j * inversion->tile_size;
+			c < MIN((j + 1) * inversion->tile_size, order); c++) {
+		for(int i = order - 1; i >= 0; i--) {
+			result[COORD(c, i, order)] /= inversion->diagonal[i];
+			vector_axpy(-result[COORD(c, i, order)], matrix + COORD(i, 0,
+				order), result + COORD(c, 0, order), i);
+		}
+	}
+}
+
+static void run_task(struct tiled_inversion *inversion, int task,
+		int thread_id) {
+	struct task *current = inversion->tasks + task;
+	int order = inversion->order;
+	int tiles = inversion->tiles;
+	int q = current->q;
+	int j = current->j;
+
+	// After a singular panel the remaining tasks only release the others
+	if(!atomic_load_explicit(&inversion->singular, memory_order_relaxed)) {
+		switch(current->type) {
+			case TASK_PANEL:
+				timing_phase(PHASE_REFLECTOR);
+				panel(inversion, q);
+				break;
+			case TASK_UPDATE:
+				timing_phase(PHASE_TRAILING);
+				reflect_tile(inversion, inversion->matrix, q, j);
+				break;
+			case TASK_APPLY:
+				timing_phase(PHASE_RESULT);
+				// result starts as the identity
+				if(q == 0) {
+					for(int c = j * inversion->tile_size;
+							c < MIN((j + 1) * inversion->tile_size, order);
+							c++) {
+						memset(inversion->result + COORD(c, 0, order), 0,
+							order * sizeof(double));
+						inversion->result[COORD(c, c, order)] = 1.0;
+					}
+				}
+				reflect_tile(inversion, inversion->result, q, j);
+				break;
+			case TASK_SOLVE:
+				timing_phase(PHASE_BACK);
+				solve(inversion, j);
+				break;
+		}
+	}
+
+	switch(current->type) {
+		case TASK_PANEL:
+			for(int i = 0; i < tiles; i++) {
+				release_task(inversion, APPLY_TASK(inversion, q, i),
+					thread_id);
+			}
+			// The next panel is on the critical path: push its update last
+			// so that this worker takes it first
+			for(int i = tiles - 1; i > q; i--) {
+				release_task(inversion, UPDATE_TASK(inversion, q, i),
+					thread_id);
+			}
+			break;
+		case TASK_UPDATE:
+			release_task(inversion, q + 1 == j ? PANEL_TASK(inversion, j) :
+				UPDATE_TASK(inversion, q + 1, j), thread_id);
+			break;
+		case TASK_APPLY:
+			release_task(inversion, q + 1 < tiles ? APPLY_TASK(inversion,
+				q + 1, j) : SOLVE_TASK(inversion, j), thread_id);
+			break;
+	}
+
+	atomic_fetch_sub(&inversion->tasks_left, 1);
+}
+
+int invert_matrix_tiled(struct tiled_inversion *inversion, int thread_id) {
+	int task;
+
+	while(atomic_load(&inversion->tasks_left) > 0) {
+		task = take_task(inversion->deques + thread_id, 1);
+		for(int i = 1; task < 0 && i < inversion->threads_amount; i++) {
+			task = take_task(inversion->deques + (thread_id + i) %
+				inversion->threads_amount, 0);
+		}
+		if(task < 0) {
+			timing_phase(PHASE_WAIT);
+			sched_yield();
+			continue;
+		}
+		run_task(inversion, task, thread_id);
+	}
+
+	return atomic_load(&inversion->singular);
+}
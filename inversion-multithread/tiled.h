@@ -0,0 +1,76 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Tiled inversion: the matrix is cut into column tiles of tile_size
+// columns and the inversion is a graph of tasks on them
+//   panel(q)     builds the reflectors of tile q
+//   update(q, j) applies the reflectors of tile q to tile j > q of matrix
+//   apply(q, j)  applies the reflectors of tile q to tile j of result
+//   solve(j)     back substitution for tile j of result
+// A task is run as soon as the tasks it depends on are done. Every worker
+// keeps the tasks it has released in its own deque and takes work from
+// the deques of the others when it runs out, so there are no barriers
+#define TILE_SIZE 64
+
+#define TASK_PANEL 0
+#define TASK_UPDATE 1
+#define TASK_APPLY 2
+#define TASK_SOLVE 3
+
+struct task {
+	atomic_int pending; // tasks it still waits for
+	int type;
+	int q;
+	int j;
+};
+
+// Owner pushes and pops at bottom, thieves take from top
+struct task_deque {
+	pthread_mutex_t mutex;
+	int *tasks;
+	int top;
+	int bottom;
+};
+
+struct tiled_inversion {
+	double *matrix;
+	double *result;
+	double *diagonal; // diagonal of R, matrix keeps the reflectors there
+	int order;
+	int tile_size;
+	int tiles;
+	int threads_amount;
+	struct task *tasks;
+	struct task_deque *deques;
+	atomic_int tasks_left;
+	atomic_int singular;
+};
+
+// Prepares the inversion of matrix into result for threads_amount workers.
+// Returns 2 if there is not enough memory
+int tiled_init(struct tiled_inversion *inversion, double *matrix,
+	double *result, int order, int tile_size, int threads_amount);
+
+void tiled_free(struct tiled_inversion *inversion);
+
+// Called by every worker, returns when all tasks are done. Returns 1 if
+// the matrix is not invertible
+int invert_matrix_tiled(struct tiled_inversion *inversion, int thread_id);
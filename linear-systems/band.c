@@ -0,0 +1,218 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "band.h"
+#include "common.h"
+#include "kernels.h"
+#include "matrixio.h"
+#include "matrixlib.h"
+
+int factorize_band(double *band, double *rotations, int order,
+		int bandwidth) {
+	double t, x, y, cos_phi, sin_phi;
+
+	for(int j = 0; j < order; j++) {
+		// Rotate rows j and i to zero A(i, j), row i has no elements
+		// past i + bandwidth <= j + 2 bandwidth, so R keeps 2 bandwidth
+		// upper diagonals
+		for(int i = j + 1; i <= MIN(j + bandwidth, order - 1); i++) {
+			x = BAND(band, j, j, bandwidth);
+			y = BAND(band, i, j, bandwidth);
+			t = sqrt(SQUARE(x) + SQUARE(y));
+			if(y == 0.0) {
+				cos_phi = 1.0;
+				sin_phi = 0.0;
+			} else {
+				cos_phi = x / t;
+				sin_phi = y / t;
+				BAND(band, j, j, bandwidth) = t;
+				BAND(band, i, j, bandwidth) = 0.0;
+				for(int l = j + 1; l <= MIN(j + 2 * bandwidth, order - 1);
+					l++) {
+					x = BAND(band, j, l, bandwidth);
+					y = BAND(band, i, l, bandwidth);
+					BAND(band, j, l, bandwidth) = cos_phi * x + sin_phi * y;
+					BAND(band, i, l, bandwidth) = -sin_phi * x + cos_phi * y;
+				}
+			}
+			rotations[COORD(j, 2 * (i - j - 1), 2 * bandwidth)] = cos_phi;
+			rotations[COORD(j, 2 * (i - j - 1) + 1, 2 * bandwidth)] = sin_phi;
+		}
+
+		if(fabs(BAND(band, j, j, bandwidth)) < EPS) {
+			return 1; // non-invertible matrix
+		}
+	}
+
+	return 0;
+}
+
+void solve_band(const double *band, const double *rotations, double *rhs,
+		int order, int bandwidth, int amount) {
+	double *y, t, cos_phi, sin_phi;
+
+	for(int k = 0; k < amount; k++) {
+		y = rhs + COORD(k, 0, order);
+
+		// y = Q^T b
+		for(int j = 0; j < order; j++) {
+			for(int i = j + 1; i <= MIN(j + bandwidth, order - 1); i++) {
+				cos_phi = rotations[COORD(j, 2 * (i - j - 1), 2 * bandwidth)];
+				sin_phi = rotations[COORD(j, 2 * (i - j - 1) + 1,
+					2 * bandwidth)];
+				t = cos_phi * y[j] + sin_phi * y[i];
+				y[i] = -sin_phi * y[j] + cos_phi * y[i];
+				y[j] = t;
+			}
+		}
+
+		// R x = y
+		for(int i = order - 1; i >= 0; i--) {
+			for(int l = i + 1; l <= MIN(i + 2 * bandwidth, order - 1); l++) {
+				y[i] -= BAND(band, i, l, bandwidth) * y[l];
+			}
+			y[i] /= BAND(band, i, i, bandwidth);
+		}
+	}
+}
+
+void invert_band(const double *band, const double *rotations,
+		double *result, int order, int bandwidth) {
+	memset(result, 0, (size_t)order * order * sizeof(double));
+	for(int i = 0; i < order; i++) {
+		result[COORD(i, i, order)] = 1.0;
+	}
+
+	solve_band(band, rotations, result, order, bandwidth, order);
+}
+
+void band_multiply(const double *band, const double *x, double *y,
+		int order, int bandwidth) {
+	int first, last;
+
+	memset(y, 0, order * sizeof(double));
+	for(int l = 0; l < order; l++) {
+		first = MAX(l - bandwidth, 0);
+		last = MIN(l + bandwidth, order - 1);
+		vector_axpy(x[l], &BAND(band, first, l, bandwidth), y + first,
+			last - first + 1);
+	}
+}
+
+void print_band(const double *band, int order, int bandwidth,
+		int max_cols_rows) {
+	int size = MIN(order, max_cols_rows);
+	double *block = (double*)malloc((size_t)size * size * sizeof(double));
+
+	if(!block) {
+		return;
+	}
+	for(int i = 0; i < size; i++) {
+		for(int j = 0; j < size; j++) {
+			block[COORD(j, i, size)] = ABS(i - j) > bandwidth ? 0.0 :
+				BAND(band, i, j, bandwidth);
+		}
+	}
+	print_matrix(block, size, size, size);
+	free(block);
+}
+
+double band_discrepancy(const double *band, const double *result,
+		int order, int bandwidth) {
+	double norm_square = 0.0;
+	double *y;
+
+	y = (double*)malloc(order * sizeof(double));
+	if(!y) {
+		return -1.0;
+	}
+
+	for(int j = 0; j < order; j++) {
+		band_multiply(band, result + COORD(j, 0, order), y, order, bandwidth);
+		y[j] -= 1.0;
+		norm_square += vector_dot(y, y, order);
+	}
+
+	free(y);
+
+	return sqrt(norm_square);
+}
+
+double estimate_band_discrepancy(const double *band, const double *result,
+		int order, int bandwidth, int probes) {
+	double norm_square = 0.0;
+	double *g, *y, *z;
+	unsigned long long state;
+
+	g = (double*)malloc(3 * (size_t)order * sizeof(double));
+	if(!g) {
+		return -1.0;
+	}
+	y = g + order;
+	z = y + order;
+
+	for(int p = 0; p < probes; p++) {
+		state = (unsigned long long)p;
+		for(int i = 0; i < order; i++) {
+			g[i] = gaussian(&state);
+			y[i] = 0.0;
+		}
+
+		for(int k = 0; k < order; k++) {
+			vector_axpy(g[k], result + COORD(k, 0, order), y, order);
+		}
+		band_multiply(band, y, z, order, bandwidth);
+		vector_axpy(-1.0, g, z, order);
+
+		norm_square += vector_dot(z, z, order);
+	}
+
+	free(g);
+
+	return sqrt(norm_square / probes);
+}
+
+double band_solution_discrepancy(const double *band, const double *solutions,
+		const double *rhs, int order, int bandwidth, int amount) {
+	double norm_square = 0.0, rhs_norm_square = 0.0;
+	double *y;
+
+	y = (double*)malloc(order * sizeof(double));
+	if(!y) {
+		return -1.0;
+	}
+
+	for(int j = 0; j < amount; j++) {
+		band_multiply(band, solutions + COORD(j, 0, order), y, order,
+			bandwidth);
+		vector_axpy(-1.0, rhs + COORD(j, 0, order), y, order);
+		norm_square += vector_dot(y, y, order);
+		rhs_norm_square += vector_dot(rhs + COORD(j, 0, order),
+			rhs + COORD(j, 0, order), order);
+	}
+
+	free(y);
+
+	if(rhs_norm_square == 0.0) {
+		return sqrt(norm_square);
+	}
+	return sqrt(norm_square / rhs_norm_square);
+}
@@ -0,0 +1,58 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+// Matrices with A(i, j) = 0 for |i - j| > bandwidth are stored by columns
+// as in LAPACK: column j holds A(j - 2 bandwidth, j), ..., A(j + bandwidth, j),
+// the upper 2 bandwidth rows are kept for the fill of R in A = Q R
+#define BAND_HEIGHT(bandwidth) (3 * (bandwidth) + 1)
+
+#define BAND(band, i, j, bandwidth) \
+	(band)[COORD(j, 2 * (bandwidth) + (i) - (j), BAND_HEIGHT(bandwidth))]
+
+// A = Q R by Givens rotations in O(n bandwidth^2), R replaces A and
+// the 2 n bandwidth cosines and sines of Q are put into rotations
+int factorize_band(double *band, double *rotations, int order,
+	int bandwidth);
+
+// Solves A x = b in place for amount right-hand sides in O(n bandwidth)
+// each
+void solve_band(const double *band, const double *rotations, double *rhs,
+	int order, int bandwidth, int amount);
+
+// Explicit inverse by n solutions in O(n^2 bandwidth)
+void invert_band(const double *band, const double *rotations,
+	double *result, int order, int bandwidth);
+
+// y = A x
+void band_multiply(const double *band, const double *x, double *y,
+	int order, int bandwidth);
+
+void print_band(const double *band, int order, int bandwidth,
+	int max_cols_rows);
+
+// |A A^{-1} - I|_F in O(n^2 bandwidth) time and O(n) memory
+double band_discrepancy(const double *band, const double *result,
+	int order, int bandwidth);
+
+// Same estimate as estimate_discrepancy() with the band A
+double estimate_band_discrepancy(const double *band, const double *result,
+	int order, int bandwidth, int probes);
+
+double band_solution_discrepancy(const double *band, const double *solutions,
+	const double *rhs, int order, int bandwidth, int amount);
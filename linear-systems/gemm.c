@@ -0,0 +1,216 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gemm.h"
+#include "common.h"
+#include "kernels.h"
+
+int multiply_matrices(const double *a, int lda, const double *b, int ldb,
+		double *c, int ldc, int m, int n, int depth, int thread_id,
+		int threads_amount) {
+	double *packed_a, *packed_b, *tile;
+	double edge[GEMM_MR * GEMM_NR];
+	int columns_start = (n * thread_id) / threads_amount;
+	int columns_end = (n * (thread_id + 1)) / threads_amount;
+	int nc, kc, mc, panels;
+
+	for(int j = columns_start; j < columns_end; j++) {
+		memset(c + COORD(j, 0, ldc), 0, m * sizeof(double));
+	}
+	if(columns_start == columns_end || m == 0 || depth == 0) {
+		return 0;
+	}
+
+	nc = MIN(GEMM_NC, columns_end - columns_start);
+	packed_a = (double*)malloc((size_t)(GEMM_MC + GEMM_MR) * GEMM_KC *
+		sizeof(double));
+	packed_b = (double*)malloc((size_t)(nc + GEMM_NR) * GEMM_KC *
+		sizeof(double));
+	if(!packed_a || !packed_b) {
+		free(packed_a);
+		free(packed_b);
+		return 2;
+	}
+
+	for(int jc = columns_start; jc < columns_end; jc += nc) {
+		nc = MIN(GEMM_NC, columns_end - jc);
+		for(int pc = 0; pc < depth; pc += kc) {
+			kc = MIN(GEMM_KC, depth - pc);
+
+			// Pack B[pc..pc+kc, jc..jc+nc] by rows of GEMM_NR columns,
+			// the last panel is padded with zeros
+			panels = (nc + GEMM_NR - 1) / GEMM_NR;
+			for(int jr = 0; jr < panels; jr++) {
+				tile = packed_b + jr * GEMM_NR * kc;
+				for(int j = 0; j < GEMM_NR; j++) {
+					if(jr * GEMM_NR + j < nc) {
+						for(int l = 0; l < kc; l++) {
+							tile[l * GEMM_NR + j] = b[COORD(jc + jr * GEMM_NR +
+								j, pc + l, ldb)];
+						}
+					} else {
+						for(int l = 0; l < kc; l++) {
+							tile[l * GEMM_NR + j] = 0.0;
+						}
+					}
+				}
+			}
+
+			for(int ic = 0; ic < m; ic += mc) {
+				mc = MIN(GEMM_MC, m - ic);
+
+				// Pack A[ic..ic+mc, pc..pc+kc] by columns of GEMM_MR rows
+				for(int ir = 0; ir < mc; ir += GEMM_MR) {
+					tile = packed_a + ir * kc;
+					for(int l = 0; l < kc; l++) {
+						for(int i = 0; i < GEMM_MR; i++) {
+							tile[l * GEMM_MR + i] = ir + i < mc ?
+								a[COORD(pc + l, ic + ir + i, lda)] : 0.0;
+						}
+					}
+				}
+
+				for(int jr = 0; jr < nc; jr += GEMM_NR) {
+					for(int ir = 0; ir < mc; ir += GEMM_MR) {
+						if(jr + GEMM_NR <= nc && ir + GEMM_MR <= mc) {
+							gemm_kernel(kc, packed_a + ir * kc,
+								packed_b + jr * kc, c + COORD(jc + jr,
+								ic + ir, ldc), ldc);
+							continue;
+						}
+
+						// Edge of C: compute the whole block aside
+						memset(edge, 0, sizeof(edge));
+						gemm_kernel(kc, packed_a + ir * kc,
+							packed_b + jr * kc, edge, GEMM_MR);
+						for(int j = 0; j < MIN(GEMM_NR, nc - jr); j++) {
+							for(int i = 0; i < MIN(GEMM_MR, mc - ir); i++) {
+								c[COORD(jc + jr + j, ic + ir + i, ldc)] +=
+									edge[COORD(j, i, GEMM_MR)];
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	free(packed_a);
+	free(packed_b);
+
+	return 0;
+}
+
+// Single precision copy of multiply_matrices()
+int multiply_matrices_float(const float *a, int lda, const float *b,
+		int ldb, float *c, int ldc, int m, int n, int depth, int thread_id,
+		int threads_amount) {
+	float *packed_a, *packed_b, *tile;
+	float edge[GEMM_MR_FLOAT * GEMM_NR];
+	int columns_start = (n * thread_id) / threads_amount;
+	int columns_end = (n * (thread_id + 1)) / threads_amount;
+	int nc, kc, mc, panels;
+
+	for(int j = columns_start; j < columns_end; j++) {
+		memset(c + COORD(j, 0, ldc), 0, m * sizeof(float));
+	}
+	if(columns_start == columns_end || m == 0 || depth == 0) {
+		return 0;
+	}
+
+	nc = MIN(GEMM_NC, columns_end - columns_start);
+	packed_a = (float*)malloc((size_t)(GEMM_MC + GEMM_MR_FLOAT) * GEMM_KC *
+		sizeof(float));
+	packed_b = (float*)malloc((size_t)(nc + GEMM_NR) * GEMM_KC *
+		sizeof(float));
+	if(!packed_a || !packed_b) {
+		free(packed_a);
+		free(packed_b);
+		return 2;
+	}
+
+	for(int jc = columns_start; jc < columns_end; jc += nc) {
+		nc = MIN(GEMM_NC, columns_end - jc);
+		for(int pc = 0; pc < depth; pc += kc) {
+			kc = MIN(GEMM_KC, depth - pc);
+
+			// Pack B[pc..pc+kc, jc..jc+nc] by rows of GEMM_NR columns,
+			// the last panel is padded with zeros
+			panels = (nc + GEMM_NR - 1) / GEMM_NR;
+			for(int jr = 0; jr < panels; jr++) {
+				tile = packed_b + jr * GEMM_NR * kc;
+				for(int j = 0; j < GEMM_NR; j++) {
+					if(jr * GEMM_NR + j < nc) {
+						for(int l = 0; l < kc; l++) {
+							tile[l * GEMM_NR + j] = b[COORD(jc + jr * GEMM_NR +
+								j, pc + l, ldb)];
+						}
+					} else {
+						for(int l = 0; l < kc; l++) {
+							tile[l * GEMM_NR + j] = 0.0f;
+						}
+					}
+				}
+			}
+
+			for(int ic = 0; ic < m; ic += mc) {
+				mc = MIN(GEMM_MC, m - ic);
+
+				// Pack A[ic..ic+mc, pc..pc+kc] by columns of GEMM_MR_FLOAT rows
+				for(int ir = 0; ir < mc; ir += GEMM_MR_FLOAT) {
+					tile = packed_a + ir * kc;
+					for(int l = 0; l < kc; l++) {
+						for(int i = 0; i < GEMM_MR_FLOAT; i++) {
+							tile[l * GEMM_MR_FLOAT + i] = ir + i < mc ?
+								a[COORD(pc + l, ic + ir + i, lda)] : 0.0f;
+						}
+					}
+				}
+
+				for(int jr = 0; jr < nc; jr += GEMM_NR) {
+					for(int ir = 0; ir < mc; ir += GEMM_MR_FLOAT) {
+						if(jr + GEMM_NR <= nc && ir + GEMM_MR_FLOAT <= mc) {
+							gemm_kernel_float(kc, packed_a + ir * kc,
+								packed_b + jr * kc, c + COORD(jc + jr,
+								ic + ir, ldc), ldc);
+							continue;
+						}
+
+						// Edge of C: compute the whole block aside
+						memset(edge, 0, sizeof(edge));
+						gemm_kernel_float(kc, packed_a + ir * kc,
+							packed_b + jr * kc, edge, GEMM_MR_FLOAT);
+						for(int j = 0; j < MIN(GEMM_NR, nc - jr); j++) {
+							for(int i = 0; i < MIN(GEMM_MR_FLOAT, mc - ir);
+									i++) {
+								c[COORD(jc + jr + j, ic + ir + i, ldc)] +=
+									edge[COORD(j, i, GEMM_MR_FLOAT)];
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	free(packed_a);
+	free(packed_b);
+
+	return 0;
+}
@@ -16,17 +16,116 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "band.h"
+#include "common.h"
+#include "kernels.h"
 #include "matrixio.h"
 #include "matrixlib.h"
+#include "structured.h"
+
+#define DEFAULT_BLOCK_SIZE 64
+
+int solve(double *matrix, int n, int m, int k, char *filename,
+		int rhs_amount, char *rhs_filename, int block_size, int mixed);
+
+int invert_structured(int n, int m, int k, int probes);
+
+int band(int n, int m, int k, char *filename, int bandwidth, int probes,
+		int rhs_amount, char *rhs_filename);
+
+int batch(int n, char *filename);
 
 int main(int argc, char **argv) {
-	int n, m, k, result;
-	double *matrix, *inverse;
+	int n, m, k, result, option;
+	int block_size = DEFAULT_BLOCK_SIZE, rhs_amount = 0, probes = 0;
+	int mixed = 0, iterations, dense = 0, bandwidth = -1, batched = 0;
+	double *matrix, *inverse, estimate, lower, upper;
 	clock_t begin, end;
 	int exit_code = 0;
-	char *filename = NULL;
+	char *filename = NULL, *rhs_filename = NULL;
+
+	// Usage: a.out [-b block_size] [-e probes] [-p] [-d] [-w bandwidth]
+	//              [-s rhs_amount [-r rhs_file]] n m k [filename]
+	//        a.out -B n m 0 filename
+	// block_size = 1 selects the unblocked reflector-by-reflector path
+	// -e estimates the discrepancy by random probes in O(n^2) per probe
+	// instead of computing it exactly
+	// -s solves A x = b for rhs_amount right-hand sides instead of
+	// inverting A, the right-hand sides are read from rhs_file or
+	// generated from A
+	// -p inverts in single precision and refines the inverse in double
+	// precision, falling back to the double precision inversion if the
+	// refinement does not converge. With -s the systems are solved by the
+	// single precision factors and the solutions are refined the same way.
+	// A step costs O(n^2) per right-hand side there but two n^3 products
+	// for the inverse, so -p only saves time with -s
+	// -d turns off the fast paths for the formulas k = 1, 2, 3 with
+	// tridiagonal inverses and for the band matrices
+	// -w gives the bandwidth max |i - j| over the nonzero elements instead
+	// of finding it by an extra pass over the input. Band matrices are
+	// kept in O(n bandwidth) memory, only the inverse takes n x n
+	// -B inverts the stream of n x n matrices in filename ("-" for the
+	// standard input) BATCH_LANES at a time and writes all inverses to
+	// the standard output
+	while((option = getopt(argc, argv, "b:e:pdw:s:r:B")) != -1) {
+		switch(option) {
+			case 'b':
+				if(sscanf(optarg, "%d", &block_size) != 1 ||
+					block_size < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'e':
+				if(sscanf(optarg, "%d", &probes) != 1 || probes < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'p':
+				mixed = 1;
+				break;
+			case 'd':
+				dense = 1;
+				break;
+			case 'w':
+				if(sscanf(optarg, "%d", &bandwidth) != 1 || bandwidth < 0) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 's':
+				if(sscanf(optarg, "%d", &rhs_amount) != 1 ||
+					rhs_amount < 1) {
+					exit_code = 1;
+					goto final;
+				}
+				break;
+			case 'r':
+				rhs_filename = optarg;
+				break;
+			case 'B':
+				batched = 1;
+				break;
+			default:
+				exit_code = 1;
+				goto final;
+		}
+	}
+	argc -= optind - 1;
+	argv += optind - 1;
+
+	init_kernels();
+
+	if(rhs_filename && !rhs_amount) {
+		exit_code = 1;
+		goto final;
+	}
+
 	if((argc < 4) || (argc > 5)) {
 		exit_code = 1;
 		goto final;
@@ -55,13 +154,47 @@ int main(int argc, char **argv) {
 		filename = argv[4];
 	}
 
-	matrix = (double*)malloc(n * n * sizeof(double));
+	if(batched) {
+		exit_code = filename ? batch(n, filename) : 1;
+		goto final;
+	}
+
+	// The inverse is built in O(n) without the n x n matrix
+	if(!dense && !mixed && !rhs_amount && formula_structured(k)) {
+		exit_code = invert_structured(n, m, k, probes);
+		goto final;
+	}
+
+	if(!dense && !mixed) {
+		if(bandwidth < 0) {
+			bandwidth = read_bandwidth(n, k, filename);
+		}
+		if(bandwidth < 0) {
+			exit_code = 4;
+			goto final;
+		}
+		// Band storage only pays off while it is smaller than the columns
+		if(BAND_HEIGHT(bandwidth) < n) {
+			exit_code = band(n, m, k, filename, bandwidth, probes,
+				rhs_amount, rhs_filename);
+			goto final;
+		}
+	}
+
+	matrix = (double*)malloc((size_t)n * n * sizeof(double));
 	if(!matrix) {
 		fprintf(stderr, "ERROR: not enough memory!");
 		exit_code = 2;
 		goto final;
 	}
-	inverse = (double*)malloc(n * n * sizeof(double));
+
+	if(rhs_amount) {
+		exit_code = solve(matrix, n, m, k, filename, rhs_amount,
+			rhs_filename, block_size, mixed);
+		goto free_matrix;
+	}
+
+	inverse = (double*)malloc((size_t)n * n * sizeof(double));
 	if(!inverse) {
 		fprintf(stderr, "ERROR: not enough memory!");
 		exit_code = 3;
@@ -78,14 +211,24 @@ int main(int argc, char **argv) {
 	printf("\n");
 
 	begin = clock();
-	result = invert_matrix(matrix, inverse, n);
+	if(mixed) {
+		result = invert_matrix_mixed(matrix, inverse, n, block_size,
+			&iterations);
+	} else {
+		result = invert_matrix_blocked(matrix, inverse, n, block_size);
+	}
 	end = clock();
 
-	if(result) {
+	if(result == 1) {
 		fprintf(stderr, "ERROR: matrix is not invertible\n");
 		exit_code = 5;
 		goto free_inverse;
 	}
+	if(result) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_inverse;
+	}
 
 	printf("Inverted matrix:\n");
 	print_matrix(inverse, n, n, m);
@@ -96,7 +239,27 @@ int main(int argc, char **argv) {
 		goto free_inverse;
 	}
 
-	printf("Discrepancy: %e\n", discrepancy(matrix, inverse, n));
+	if(probes) {
+		estimate = estimate_discrepancy(matrix, inverse, n, probes);
+		if(estimate < 0.0) {
+			fprintf(stderr, "ERROR: not enough memory!");
+			exit_code = 3;
+			goto free_inverse;
+		}
+		discrepancy_bounds(estimate, probes, &lower, &upper);
+		printf("Discrepancy estimate: %e (%d probes)\n", estimate, probes);
+		printf("95%% confidence interval: [%e, %e]\n", lower, upper);
+	} else {
+		printf("Discrepancy: %e\n", discrepancy(matrix, inverse, n));
+	}
+	if(mixed) {
+		if(iterations < 0) {
+			printf("Refinement did not converge, inverted in double "
+				"precision\n");
+		} else {
+			printf("Refinement steps: %d\n", iterations);
+		}
+	}
 	printf("Time used to compute: %.2lf seconds\n", (double)(end - begin)
 		/ CLOCKS_PER_SEC);
 
@@ -106,4 +269,353 @@ int main(int argc, char **argv) {
 	free(matrix);
 	final:
 	return exit_code;
-}
\ No newline at end of file
+}
+
+int invert_structured(int n, int m, int k, int probes) {
+	double *diagonals, corner, value, lower, upper;
+	clock_t begin, end;
+	int exit_code = 0;
+
+	diagonals = (double*)malloc(2 * (size_t)n * sizeof(double));
+	if(!diagonals) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto final;
+	}
+
+	printf("Original matrix:\n");
+	print_formula(n, k, m);
+	printf("\n");
+
+	begin = clock();
+	exit_code = invert_formula(diagonals, &corner, n, k);
+	end = clock();
+
+	if(exit_code) {
+		fprintf(stderr, "ERROR: matrix is not invertible\n");
+		exit_code = 5;
+		goto free_diagonals;
+	}
+
+	printf("Inverted matrix:\n");
+	print_structured(diagonals, corner, n, m);
+	printf("\n");
+
+	if(probes) {
+		value = estimate_structured_discrepancy(diagonals, corner, n, k,
+			probes);
+	} else {
+		value = structured_discrepancy(diagonals, corner, n, k);
+	}
+	if(value < 0.0) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_diagonals;
+	}
+	if(probes) {
+		discrepancy_bounds(value, probes, &lower, &upper);
+		printf("Discrepancy estimate: %e (%d probes)\n", value, probes);
+		printf("95%% confidence interval: [%e, %e]\n", lower, upper);
+	} else {
+		printf("Discrepancy: %e\n", value);
+	}
+	printf("Time used to compute: %.2lf seconds\n", (double)(end - begin)
+		/ CLOCKS_PER_SEC);
+
+	free_diagonals:
+	free(diagonals);
+	final:
+	return exit_code;
+}
+
+int band(int n, int m, int k, char *filename, int bandwidth, int probes,
+		int rhs_amount, char *rhs_filename) {
+	double *matrix, *rotations, *rhs = NULL, *result, value, lower, upper;
+	clock_t begin, middle, end;
+	int exit_code = 0;
+
+	matrix = (double*)malloc((size_t)n * BAND_HEIGHT(bandwidth) *
+		sizeof(double));
+	if(!matrix) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 2;
+		goto final;
+	}
+	rotations = (double*)malloc(2 * (size_t)n * MAX(bandwidth, 1) *
+		sizeof(double));
+	if(!rotations) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_matrix;
+	}
+	// Solutions or the inverse
+	result = (double*)malloc((size_t)n * (rhs_amount ? rhs_amount : n) *
+		sizeof(double));
+	if(!result) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_rotations;
+	}
+	if(rhs_amount) {
+		rhs = (double*)malloc((size_t)n * rhs_amount * sizeof(double));
+		if(!rhs) {
+			fprintf(stderr, "ERROR: not enough memory!");
+			exit_code = 3;
+			goto free_result;
+		}
+	}
+
+	if(read_band_matrix(matrix, n, bandwidth, k, filename)) {
+		exit_code = 4;
+		goto free_rhs;
+	}
+
+	printf("Original matrix:\n");
+	print_band(matrix, n, bandwidth, m);
+	printf("\n");
+
+	if(rhs_amount && read_band_rhs(result, matrix, n, bandwidth, rhs_amount,
+		rhs_filename)) {
+		exit_code = 4;
+		goto free_rhs;
+	}
+
+	begin = clock();
+	exit_code = factorize_band(matrix, rotations, n, bandwidth);
+	middle = clock();
+
+	if(exit_code) {
+		fprintf(stderr, "ERROR: matrix is not invertible\n");
+		exit_code = 5;
+		goto free_rhs;
+	}
+
+	if(rhs_amount) {
+		solve_band(matrix, rotations, result, n, bandwidth, rhs_amount);
+	} else {
+		invert_band(matrix, rotations, result, n, bandwidth);
+	}
+	end = clock();
+
+	printf(rhs_amount ? "Solutions:\n" : "Inverted matrix:\n");
+	print_matrix(result, n, rhs_amount ? rhs_amount : n, m);
+	printf("\n");
+
+	if(read_band_matrix(matrix, n, bandwidth, k, filename) || (rhs_amount &&
+		read_band_rhs(rhs, matrix, n, bandwidth, rhs_amount, rhs_filename))) {
+		exit_code = 4;
+		goto free_rhs;
+	}
+
+	if(rhs_amount) {
+		value = band_solution_discrepancy(matrix, result, rhs, n, bandwidth,
+			rhs_amount);
+	} else if(probes) {
+		value = estimate_band_discrepancy(matrix, result, n, bandwidth,
+			probes);
+	} else {
+		value = band_discrepancy(matrix, result, n, bandwidth);
+	}
+	if(value < 0.0) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_rhs;
+	}
+
+	if(rhs_amount) {
+		printf("Relative discrepancy: %e\n", value);
+		printf("Time used to factorize: %.2lf seconds\n",
+			(double)(middle - begin) / CLOCKS_PER_SEC);
+		printf("Time used to solve: %.2lf seconds\n",
+			(double)(end - middle) / CLOCKS_PER_SEC);
+	} else {
+		if(probes) {
+			discrepancy_bounds(value, probes, &lower, &upper);
+			printf("Discrepancy estimate: %e (%d probes)\n", value, probes);
+			printf("95%% confidence interval: [%e, %e]\n", lower, upper);
+		} else {
+			printf("Discrepancy: %e\n", value);
+		}
+		printf("Time used to compute: %.2lf seconds\n", (double)(end - begin)
+			/ CLOCKS_PER_SEC);
+	}
+
+	free_rhs:
+	free(rhs);
+	free_result:
+	free(result);
+	free_rotations:
+	free(rotations);
+	free_matrix:
+	free(matrix);
+	final:
+	return exit_code;
+}
+
+int batch(int n, char *filename) {
+	double *matrices, *inverses;
+	int failed[BATCH_LANES], amount;
+	long int total = 0, singular = 0;
+	clock_t begin, end;
+	int exit_code = 0;
+	FILE *fin = stdin;
+
+	matrices = (double*)malloc((size_t)n * n * BATCH_LANES * sizeof(double));
+	if(!matrices) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 2;
+		goto final;
+	}
+	inverses = (double*)malloc((size_t)n * n * BATCH_LANES * sizeof(double));
+	if(!inverses) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_matrices;
+	}
+	if(strcmp(filename, "-")) {
+		fin = fopen(filename, "r");
+		if(!fin) {
+			perror("ERROR: failed to open file");
+			exit_code = 4;
+			goto free_inverses;
+		}
+	}
+
+	// The time includes reading and writing
+	begin = clock();
+	while((amount = read_batch(fin, matrices, n)) > 0) {
+		invert_batch(matrices, inverses, n, failed);
+		write_batch(inverses, failed, n, amount);
+		total += amount;
+		for(int l = 0; l < amount; l++) {
+			singular += failed[l];
+		}
+	}
+	end = clock();
+
+	if(amount < 0) {
+		exit_code = 4;
+		goto close_file;
+	}
+
+	fprintf(stderr, "Inverted %ld matrices, %ld of them are not "
+		"invertible\n", total, singular);
+	fprintf(stderr, "Time used to compute: %.2lf seconds\n",
+		(double)(end - begin) / CLOCKS_PER_SEC);
+
+	close_file:
+	if(fin != stdin) {
+		fclose(fin);
+	}
+	free_inverses:
+	free(inverses);
+	free_matrices:
+	free(matrices);
+	final:
+	return exit_code;
+}
+
+int solve(double *matrix, int n, int m, int k, char *filename,
+		int rhs_amount, char *rhs_filename, int block_size, int mixed) {
+	double *tau, *rhs, *solutions;
+	clock_t begin, middle, end;
+	int exit_code = 0, iterations;
+
+	tau = (double*)malloc(n * sizeof(double));
+	if(!tau) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto final;
+	}
+	rhs = (double*)malloc((size_t)n * rhs_amount * sizeof(double));
+	if(!rhs) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_tau;
+	}
+	solutions = (double*)malloc((size_t)n * rhs_amount * sizeof(double));
+	if(!solutions) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_rhs;
+	}
+
+	if(read_matrix(matrix, n, k, filename)) {
+		exit_code = 4;
+		goto free_solutions;
+	}
+
+	printf("Original matrix:\n");
+	print_matrix(matrix, n, n, m);
+	printf("\n");
+
+	// solutions hold the right-hand sides until they are solved in place
+	if(read_rhs(solutions, matrix, n, rhs_amount, rhs_filename)) {
+		exit_code = 4;
+		goto free_solutions;
+	}
+
+	// The mixed precision solve refines the solutions against the intact
+	// matrix, so the factorization and the solve are not timed apart
+	begin = clock();
+	if(mixed) {
+		exit_code = solve_systems_mixed(matrix, solutions, n, rhs_amount,
+			block_size, &iterations);
+	} else {
+		exit_code = factorize_matrix(matrix, tau, n, block_size);
+	}
+	middle = clock();
+
+	if(exit_code == 1) {
+		fprintf(stderr, "ERROR: matrix is not invertible\n");
+		exit_code = 5;
+		goto free_solutions;
+	}
+	if(exit_code) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		exit_code = 3;
+		goto free_solutions;
+	}
+
+	if(!mixed) {
+		solve_systems(matrix, tau, solutions, n, rhs_amount);
+	}
+	end = clock();
+
+	printf("Solutions:\n");
+	print_matrix(solutions, n, rhs_amount, m);
+	printf("\n");
+
+	if(read_matrix(matrix, n, k, filename) ||
+		read_rhs(rhs, matrix, n, rhs_amount, rhs_filename)) {
+		exit_code = 4;
+		goto free_solutions;
+	}
+
+	printf("Relative discrepancy: %e\n", solution_discrepancy(matrix,
+		solutions, rhs, n, rhs_amount));
+	if(mixed) {
+		if(iterations < 0) {
+			printf("Refinement did not converge, solved in double "
+				"precision\n");
+		} else {
+			printf("Refinement steps: %d\n", iterations);
+		}
+		printf("Time used to compute: %.2lf seconds\n",
+			(double)(end - begin) / CLOCKS_PER_SEC);
+	} else {
+		printf("Time used to factorize: %.2lf seconds\n",
+			(double)(middle - begin) / CLOCKS_PER_SEC);
+		printf("Time used to solve: %.2lf seconds\n",
+			(double)(end - middle) / CLOCKS_PER_SEC);
+	}
+
+	free_solutions:
+	free(solutions);
+	free_rhs:
+	free(rhs);
+	free_tau:
+	free(tau);
+	final:
+	return exit_code;
+}
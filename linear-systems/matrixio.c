@@ -14,9 +14,15 @@
  * limitations under the License.
  */
 
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
+#include <string.h>
+
+#include "band.h"
 #include "common.h"
+#include "kernels.h"
 #include "matrixio.h"
 
 int read_matrix(double *matrix, int order, int formula_number,
@@ -56,6 +62,218 @@ int read_matrix(double *matrix, int order, int formula_number,
 	return 0;
 }
 
+int read_rhs(double *rhs, const double *matrix, int order, int amount,
+	char *filename) {
+	if(filename) {
+		FILE *fin = fopen(filename, "r");
+		int result = 0;
+		if(!fin) {
+			perror("ERROR: failed to open file");
+			return 1;
+		}
+		for(int j = 0; j < amount; j++) {
+			for(int i = 0; i < order; i++) {
+				result = fscanf(fin, "%lf", rhs + COORD(j, i, order));
+				if(result != 1) {
+					if(result == EOF) {
+						fprintf(stderr,
+							"ERROR: unexcepted EOF while reading vectors\n");
+					} else {
+						fprintf(stderr,
+							"ERROR: got invalid data while reading vectors\n");
+					}
+					fclose(fin);
+					return 1;
+				}
+			}
+		}
+		fclose(fin);
+	} else {
+		// b_j = A x_j, where x_j[i] = 1 if i + j is even and 0 otherwise
+		for(int j = 0; j < amount; j++) {
+			for(int i = 0; i < order; i++) {
+				rhs[COORD(j, i, order)] = 0.0;
+			}
+			for(int k = (j % 2); k < order; k += 2) {
+				for(int i = 0; i < order; i++) {
+					rhs[COORD(j, i, order)] += matrix[COORD(k, i, order)];
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+int read_bandwidth(int order, int formula_number, char *filename) {
+	double value;
+	int bandwidth = 0;
+
+	if(filename) {
+		// One streaming pass, nothing is stored
+		FILE *fin = fopen(filename, "r");
+		int result = 0;
+		if(!fin) {
+			perror("ERROR: failed to open file");
+			return -1;
+		}
+		for(int i = 0; i < order && BAND_HEIGHT(bandwidth) < order; i++) {
+			for(int j = 0; j < order; j++) {
+				result = fscanf(fin, "%lf", &value);
+				if(result != 1) {
+					if(result == EOF) {
+						fprintf(stderr,
+							"ERROR: unexcepted EOF while reading matrix\n");
+					} else {
+						fprintf(stderr,
+							"ERROR: got invalid data while reading matrix\n");
+					}
+					fclose(fin);
+					return -1;
+				}
+				if(value != 0.0) {
+					bandwidth = MAX(bandwidth, ABS(i - j));
+				}
+			}
+		}
+		fclose(fin);
+	} else {
+		for(int i = 0; i < order && BAND_HEIGHT(bandwidth) < order; i++) {
+			for(int j = 0; j < order; j++) {
+				if(ABS(i - j) > bandwidth &&
+					f(order, formula_number, i + 1, j + 1) != 0.0) {
+					bandwidth = ABS(i - j);
+				}
+			}
+		}
+	}
+	return bandwidth;
+}
+
+int read_band_matrix(double *band, int order, int bandwidth,
+	int formula_number, char *filename) {
+	double value;
+
+	memset(band, 0, (size_t)order * BAND_HEIGHT(bandwidth) * sizeof(double));
+	if(filename) {
+		FILE *fin = fopen(filename, "r");
+		int result = 0;
+		if(!fin) {
+			perror("ERROR: failed to open file");
+			return 1;
+		}
+		for(int i = 0; i < order; i++) {
+			for(int j = 0; j < order; j++) {
+				result = fscanf(fin, "%lf", &value);
+				if(result != 1) {
+					if(result == EOF) {
+						fprintf(stderr,
+							"ERROR: unexcepted EOF while reading matrix\n");
+					} else {
+						fprintf(stderr,
+							"ERROR: got invalid data while reading matrix\n");
+					}
+					fclose(fin);
+					return 1;
+				}
+				if(ABS(i - j) <= bandwidth) {
+					BAND(band, i, j, bandwidth) = value;
+				} else if(value != 0.0) {
+					fprintf(stderr,
+						"ERROR: matrix does not fit the bandwidth\n");
+					fclose(fin);
+					return 1;
+				}
+			}
+		}
+		fclose(fin);
+	} else {
+		for(int i = 0; i < order; i++) {
+			for(int j = MAX(i - bandwidth, 0);
+				j <= MIN(i + bandwidth, order - 1); j++) {
+				BAND(band, i, j, bandwidth) = f(order, formula_number, i + 1,
+					j + 1);
+			}
+		}
+	}
+	return 0;
+}
+
+int read_band_rhs(double *rhs, const double *band, int order, int bandwidth,
+	int amount, char *filename) {
+	double *x;
+
+	if(filename) {
+		return read_rhs(rhs, NULL, order, amount, filename);
+	}
+
+	// Same right-hand sides as read_rhs() generates
+	x = (double*)malloc(order * sizeof(double));
+	if(!x) {
+		fprintf(stderr, "ERROR: not enough memory!");
+		return 1;
+	}
+	for(int j = 0; j < amount; j++) {
+		for(int i = 0; i < order; i++) {
+			x[i] = (double)((i + j) % 2 == 0);
+		}
+		band_multiply(band, x, rhs + COORD(j, 0, order), order, bandwidth);
+	}
+	free(x);
+	return 0;
+}
+
+int read_batch(FILE *fin, double *batch, int order) {
+	int result = 0, amount = 0;
+
+	for(; amount < BATCH_LANES; amount++) {
+		for(int i = 0; i < order; i++) {
+			for(int j = 0; j < order; j++) {
+				result = fscanf(fin, "%lf",
+					batch + COORD(COORD(j, i, order), amount, BATCH_LANES));
+				if(result == EOF && i == 0 && j == 0) {
+					goto pad;
+				}
+				if(result != 1) {
+					if(result == EOF) {
+						fprintf(stderr,
+							"ERROR: unexcepted EOF while reading matrix\n");
+					} else {
+						fprintf(stderr,
+							"ERROR: got invalid data while reading matrix\n");
+					}
+					return -1;
+				}
+			}
+		}
+	}
+
+	pad:
+	// Unused lanes get the identity matrix
+	for(int l = amount; l < BATCH_LANES; l++) {
+		for(int i = 0; i < order; i++) {
+			for(int j = 0; j < order; j++) {
+				batch[COORD(COORD(j, i, order), l, BATCH_LANES)] =
+					(double)(i == j);
+			}
+		}
+	}
+	return amount;
+}
+
+void write_batch(const double *batch, const int *failed, int order,
+	int amount) {
+	for(int l = 0; l < amount; l++) {
+		for(int i = 0; i < order; i++) {
+			for(int j = 0; j < order; j++) {
+				printf(j ? " %.17g" : "%.17g", failed[l] ? NAN :
+					batch[COORD(COORD(j, i, order), l, BATCH_LANES)]);
+			}
+			printf("\n");
+		}
+		printf("\n");
+	}
+}
+
 void print_matrix(double *matrix, int height, int width, int max_cols_rows) {
 	int print_limit_x = MIN(width, max_cols_rows);
 	int print_limit_y = MIN(height, max_cols_rows);
@@ -65,4 +283,20 @@ void print_matrix(double *matrix, int height, int width, int max_cols_rows) {
 		}
 		printf("\n");
 	}
-}
\ No newline at end of file
+}
+
+void print_formula(int order, int formula_number, int max_cols_rows) {
+	int size = MIN(order, max_cols_rows);
+	double *block = (double*)malloc((size_t)size * size * sizeof(double));
+
+	if(!block) {
+		return;
+	}
+	for(int i = 0; i < size; i++) {
+		for(int j = 0; j < size; j++) {
+			block[COORD(j, i, size)] = f(order, formula_number, i + 1, j + 1);
+		}
+	}
+	print_matrix(block, size, size, size);
+	free(block);
+}
@@ -16,7 +16,38 @@
 
 #pragma once
 
+#include <stdio.h>
+
 int read_matrix(double *matrix, int order, int formula_number,
 	char *filename);
 
-void print_matrix(double *matrix, int height, int width, int max_cols_rows);
\ No newline at end of file
+int read_rhs(double *rhs, const double *matrix, int order, int amount,
+	char *filename);
+
+// Largest |i - j| over the nonzero elements, the file is read without
+// storing it. The scan stops at the first row where BAND_HEIGHT() of the
+// bandwidth so far reaches the order, so the result is only a lower bound
+// then. Returns -1 on the read error
+int read_bandwidth(int order, int formula_number, char *filename);
+
+// Reads the matrix into the band storage of band.h
+int read_band_matrix(double *band, int order, int bandwidth,
+	int formula_number, char *filename);
+
+int read_band_rhs(double *rhs, const double *band, int order, int bandwidth,
+	int amount, char *filename);
+
+// Reads up to BATCH_LANES order x order matrices from the stream into the
+// interleaved layout of kernels.h, the unused lanes are filled with the
+// identity. Returns the amount of matrices read or -1 on the read error
+int read_batch(FILE *fin, double *batch, int order);
+
+// Writes the inverses of the amount first lanes in full precision, the
+// failed ones are written as NaN
+void write_batch(const double *batch, const int *failed, int order,
+	int amount);
+
+void print_matrix(double *matrix, int height, int width, int max_cols_rows);
+
+// Prints the upper left corner of the formula matrix without forming it
+void print_formula(int order, int formula_number, int max_cols_rows);
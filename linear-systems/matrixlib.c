@@ -14,14 +14,156 @@
  * limitations under the License.
  */
 
+#include <float.h>
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "matrixlib.h"
 #include "common.h"
+#include "kernels.h"
+#include "gemm.h"
+
+// Right-hand sides reflected at once by solve_systems()
+#define BLOCK_COLUMNS 64
+
+// Column chunk of the packed products of the blocked engine, wide enough
+// that packing the panel of V or R is paid for by many columns
+#define UPDATE_COLUMNS 256
+
+// Width of the panel of A * A^{-1} formed at once by discrepancy()
+// and by the iterative refinement
+#define RESIDUAL_COLUMNS 256
+
+// Limit of the iterative refinement steps of the mixed precision inversion
+// and solve
+#define REFINEMENT_ITERATIONS 30
+
+// Offset of the element with the given index in the interleaved batch
+#define LANE(index) ((size_t)(index) * BATCH_LANES)
+
+// Largest order with the specialized inversion. It sums in another order
+// than the general path, so the orders where a pivot can come near EPS
+// (the Hilbert matrix of order 16) are left to the general path to give
+// the same verdict
+#define FIXED_ORDER_MAX 8
+
+#define UNROLL _Pragma("GCC unroll 16")
+
+// Householder inversion of the order n matrix specialized at compile time:
+// the loops have constant bounds and are unrolled, the matrices are kept
+// in local arrays (column j of A is a[j]) and the singularity is checked
+// once at the end instead of a branch per step. The sign of the
+// reflection is chosen as in the blocked path, so no step is skipped
+#define FIXED_INVERSE(n) \
+static int invert_matrix_##n(double *matrix, double *result) { \
+	double a[n][n], x[n][n], s, norm, d; \
+	int singular = 0; \
+	memcpy(a, matrix, sizeof(a)); \
+	for(int j = 0; j < n; j++) { \
+		UNROLL for(int i = 0; i < n; i++) { \
+			x[j][i] = (double)(i == j); \
+		} \
+	} \
+	for(int k = 0; k < n; k++) { \
+		s = 0.0; \
+		UNROLL for(int i = k + 1; i < n; i++) { \
+			s += a[k][i] * a[k][i]; \
+		} \
+		norm = copysign(sqrt(a[k][k] * a[k][k] + s), a[k][k]); \
+		singular |= fabs(norm) < EPS; \
+		a[k][k] += norm; \
+		s = 2.0 / (a[k][k] * a[k][k] + s); \
+		for(int j = k + 1; j < n; j++) { \
+			d = 0.0; \
+			UNROLL for(int i = k; i < n; i++) { \
+				d += a[k][i] * a[j][i]; \
+			} \
+			d *= s; \
+			UNROLL for(int i = k; i < n; i++) { \
+				a[j][i] -= d * a[k][i]; \
+			} \
+		} \
+		for(int j = 0; j < n; j++) { \
+			d = 0.0; \
+			UNROLL for(int i = k; i < n; i++) { \
+				d += a[k][i] * x[j][i]; \
+			} \
+			d *= s; \
+			UNROLL for(int i = k; i < n; i++) { \
+				x[j][i] -= d * a[k][i]; \
+			} \
+		} \
+		a[k][k] = -norm; \
+	} \
+	if(singular) { \
+		return 1; /* non-invertible matrix */ \
+	} \
+	for(int k = n - 1; k >= 0; k--) { \
+		d = 1.0 / a[k][k]; \
+		for(int j = 0; j < n; j++) { \
+			x[j][k] *= d; \
+			UNROLL for(int i = 0; i < k; i++) { \
+				x[j][i] -= x[j][k] * a[k][i]; \
+			} \
+		} \
+	} \
+	memcpy(result, x, sizeof(x)); \
+	return 0; \
+}
+
+FIXED_INVERSE(2)
+FIXED_INVERSE(3)
+FIXED_INVERSE(4)
+FIXED_INVERSE(8)
+
+static int (*const fixed_inverses[FIXED_ORDER_MAX + 1])(double *matrix,
+		double *result) = {
+	[2] = invert_matrix_2,
+	[3] = invert_matrix_3,
+	[4] = invert_matrix_4,
+	[8] = invert_matrix_8
+};
+
+static int householder_blocked(double *matrix, double *result, double *tau,
+		int order, int block_size);
+
+static void back_substitution(double *matrix, double *result, int order);
+
+static int back_substitution_blocked(const double *matrix, double *result,
+		int order, int block_size);
+
+static int invert_matrix_float(float *matrix, float *result, int order,
+		int block_size);
+
+static int householder_blocked_float(float *matrix, float *result,
+		float *tau, int order, int block_size);
+
+static int apply_block_reflector_float(const float *v, const float *vt,
+		float *target, int order, int first, int block, int columns_start,
+		int columns_end, const float *t, int block_size, float *w,
+		float *x);
+
+static int back_substitution_blocked_float(const float *matrix,
+		float *result, int order, int block_size);
+
+static void solve_systems_float(const float *matrix, const float *tau,
+		float *rhs, int order, int amount);
+
+static int refine_inverse(const double *matrix, double *result,
+		double *previous, int order, double *work);
+
+static int apply_block_reflector(const double *v, const double *vt,
+		double *target, int order, int first, int block, int columns_start,
+		int columns_end, const double *t, int block_size, double *w,
+		double *x);
 
 int invert_matrix(double *matrix, double *result, int order) {
-	double s, norm1, norm2_square, tmp;
+	double s, norm1, norm2_square;
+
+	if(order <= FIXED_ORDER_MAX && fixed_inverses[order]) {
+		return fixed_inverses[order](matrix, result);
+	}
 
 	// Generate the identity matrix
 
@@ -31,10 +173,8 @@ int invert_matrix(double *matrix, double *result, int order) {
 	
 	// Cast the matrix to upper triangular type
 	for(int i = 0; i < order; i++) {
-		s = 0.0;
-		for(int j = i + 1; j < order; j++){
-			s += SQUARE(matrix[COORD(i, j, order)]);
-		}
+		s = vector_dot(matrix + COORD(i, i + 1, order),
+			matrix + COORD(i, i + 1, order), order - i - 1);
 
 		norm1 = sqrt(SQUARE(matrix[COORD(i, i, order)]) + s);
 
@@ -54,33 +194,829 @@ int invert_matrix(double *matrix, double *result, int order) {
 		// Vector of reflection is ready, now we need to operate on matrices
 
 		for(int j = i + 1; j < order; j++) {
-			s = 0.0;
-			for(int k = i; k < order; k++) {
-				s += matrix[COORD(i, k, order)] * matrix[COORD(j, k, order)];
+			vector_reflect(norm2_square, matrix + COORD(i, i, order),
+				matrix + COORD(j, i, order), order - i);
+		}
+
+		for(int j = 0; j < order; j++) {
+			vector_reflect(norm2_square, matrix + COORD(i, i, order),
+				result + COORD(j, i, order), order - i);
+		}
+
+		// Finalize: set the i-th subcolumn of matrix
+		matrix[COORD(i, i, order)] = norm1;
+	}
+
+	back_substitution(matrix, result, order);
+
+	// And... here we go
+	return 0;
+}
+
+int invert_matrix_blocked(double *matrix, double *result, int order,
+		int block_size) {
+	double *tau;
+	int error;
+
+	if(block_size <= 1 || (order <= FIXED_ORDER_MAX &&
+		fixed_inverses[order])) {
+		return invert_matrix(matrix, result, order);
+	}
+
+	tau = (double*)malloc(order * sizeof(double));
+	if(!tau) {
+		return 2;
+	}
+
+	memset(result, 0, (size_t)order * order * sizeof(double));
+	for(int i = 0; i < order; i++)
+		result[COORD(i, i, order)] = 1.0;
+
+	error = householder_blocked(matrix, result, tau, order, block_size);
+	free(tau);
+	if(error) {
+		return error;
+	}
+
+	return back_substitution_blocked(matrix, result, order, block_size);
+}
+
+int invert_matrix_mixed(double *matrix, double *result, int order,
+		int block_size, int *iterations) {
+	float *matrix_float, *result_float;
+	double *previous, *work;
+	int error;
+
+	*iterations = -1;
+
+	// Initial approximation X_0 by the single precision Householder method
+	matrix_float = (float*)malloc((size_t)order * order * sizeof(float));
+	result_float = (float*)malloc((size_t)order * order * sizeof(float));
+	if(!matrix_float || !result_float) {
+		free(matrix_float);
+		free(result_float);
+		return 2;
+	}
+	for(size_t i = 0; i < (size_t)order * order; i++) {
+		matrix_float[i] = (float)matrix[i];
+	}
+	error = invert_matrix_float(matrix_float, result_float, order,
+		block_size);
+	for(size_t i = 0; i < (size_t)order * order; i++) {
+		result[i] = result_float[i];
+	}
+	free(matrix_float);
+	free(result_float);
+
+	if(!error) {
+		previous = (double*)malloc((size_t)order * order * sizeof(double));
+		work = (double*)malloc(2 * (size_t)order * RESIDUAL_COLUMNS *
+			sizeof(double));
+		if(!previous || !work) {
+			free(previous);
+			free(work);
+			return 2;
+		}
+		*iterations = refine_inverse(matrix, result, previous, order, work);
+		free(previous);
+		free(work);
+	}
+
+	// Single precision factorization broke down or the refinement did not
+	// converge: matrix is still intact, use the double precision path
+	if(*iterations < 0) {
+		return invert_matrix_blocked(matrix, result, order, block_size);
+	}
+
+	return 0;
+}
+
+void invert_batch(double *batch, double *result, int order, int *failed) {
+	double s[BATCH_LANES], scale[BATCH_LANES], diagonal[BATCH_LANES];
+	double coefficient[BATCH_LANES], norm1, *a;
+
+	memset(result, 0, LANE(order * order) * sizeof(double));
+	for(int i = 0; i < order; i++) {
+		for(int l = 0; l < BATCH_LANES; l++) {
+			result[LANE(COORD(i, i, order)) + l] = 1.0;
+		}
+	}
+	for(int l = 0; l < BATCH_LANES; l++) {
+		failed[l] = 0;
+	}
+
+	// Householder method of invert_matrix() in every lane, a lane with
+	// nothing to do or with a singular matrix gets a zero scale
+	for(int i = 0; i < order; i++) {
+		a = batch + LANE(COORD(i, i, order));
+		for(int l = 0; l < BATCH_LANES; l++) {
+			s[l] = 0.0;
+		}
+		for(int k = 1; k < order - i; k++) {
+			for(int l = 0; l < BATCH_LANES; l++) {
+				s[l] += SQUARE(a[LANE(k) + l]);
 			}
+		}
 
-			s *= norm2_square;
-			for(int k = i; k < order; k++) {
-				matrix[COORD(j, k, order)] -= s * matrix[COORD(i, k, order)];
+		for(int l = 0; l < BATCH_LANES; l++) {
+			norm1 = sqrt(SQUARE(a[l]) + s[l]);
+			scale[l] = 0.0;
+			diagonal[l] = a[l];
+			if(norm1 < EPS) {
+				failed[l] = 1; // non-invertible matrix
+				continue;
+			}
+			if(s[l] < EPS) {
+				continue;
 			}
+			if(a[l] > 0.0) {
+				norm1 = -norm1;
+			}
+			a[l] -= norm1;
+			scale[l] = 2.0 / (SQUARE(a[l]) + s[l]);
+			diagonal[l] = norm1;
 		}
 
+		for(int j = i + 1; j < order; j++) {
+			batch_reflect(scale, a, batch + LANE(COORD(j, i, order)),
+				order - i);
+		}
 		for(int j = 0; j < order; j++) {
-			s = 0.0;
-			for(int k = i; k < order; k++) {
-				s += matrix[COORD(i, k, order)] * result[COORD(j, k, order)];
+			batch_reflect(scale, a, result + LANE(COORD(j, i, order)),
+				order - i);
+		}
+
+		for(int l = 0; l < BATCH_LANES; l++) {
+			a[l] = diagonal[l];
+		}
+	}
+
+	// Back substitution in every lane
+	for(int i = order - 1; i >= 0; i--) {
+		a = batch + LANE(COORD(i, i, order));
+		for(int j = 0; j < order; j++) {
+			for(int l = 0; l < BATCH_LANES; l++) {
+				result[LANE(COORD(j, i, order)) + l] /= a[l];
+				coefficient[l] = -result[LANE(COORD(j, i, order)) + l];
 			}
+			batch_axpy(coefficient, batch + LANE(COORD(i, 0, order)),
+				result + LANE(COORD(j, 0, order)), i);
+		}
+	}
+}
 
-			s *= norm2_square;
-			for(int k = i; k < order; k++) {
-				result[COORD(j, k, order)] -= s * matrix[COORD(i, k, order)];
+int factorize_matrix(double *matrix, double *tau, int order,
+		int block_size) {
+	return householder_blocked(matrix, NULL, tau, order, MAX(block_size, 1));
+}
+
+void solve_systems(const double *matrix, const double *tau, double *rhs,
+		int order, int amount) {
+	double s;
+	double *x;
+	int chunk;
+
+	for(int c = 0; c < amount; c += chunk) {
+		chunk = MIN(BLOCK_COLUMNS, amount - c);
+
+		// Apply Q^T = H_{n-1} ... H_0 reflector by reflector, but to the
+		// whole chunk of right-hand sides at once so that v stays in cache
+		for(int i = 0; i < order; i++) {
+			if(tau[i] == 0.0) {
+				continue;
+			}
+			for(int j = c; j < c + chunk; j++) {
+				x = rhs + COORD(j, 0, order);
+				s = tau[i] * (x[i] + vector_dot(matrix + COORD(i, i + 1,
+					order), x + i + 1, order - i - 1));
+				x[i] -= s;
+				vector_axpy(-s, matrix + COORD(i, i + 1, order), x + i + 1,
+					order - i - 1);
 			}
 		}
 
-		// Finalize: set the i-th subcolumn of matrix
-		matrix[COORD(i, i, order)] = norm1;
+		// Back substitution with R, column by column of R
+		for(int i = order - 1; i >= 0; i--) {
+			for(int j = c; j < c + chunk; j++) {
+				x = rhs + COORD(j, 0, order);
+				x[i] /= matrix[COORD(i, i, order)];
+				vector_axpy(-x[i], matrix + COORD(i, 0, order), x, i);
+			}
+		}
+	}
+}
+
+int solve_systems_mixed(const double *matrix, double *rhs, int order,
+		int amount, int block_size, int *iterations) {
+	float *matrix_float, *tau_float, *correction;
+	double *copy, *residual, *factors, *tau, matrix_norm = 0.0, norm;
+	double solution_norm, previous_norm = INFINITY;
+	int error, chunk;
+	size_t size = (size_t)order * amount;
+
+	*iterations = -1;
+
+	matrix_float = (float*)malloc((size_t)order * order * sizeof(float));
+	tau_float = (float*)malloc(order * sizeof(float));
+	correction = (float*)malloc(size * sizeof(float));
+	copy = (double*)malloc(size * sizeof(double));
+	residual = (double*)malloc(size * sizeof(double));
+	if(!matrix_float || !tau_float || !correction || !copy || !residual) {
+		error = 2;
+		goto free_all;
+	}
+
+	for(size_t i = 0; i < (size_t)order * order; i++) {
+		matrix_float[i] = (float)matrix[i];
+		matrix_norm += SQUARE(matrix[i]);
+	}
+	matrix_norm = sqrt(matrix_norm);
+	memcpy(copy, rhs, size * sizeof(double));
+
+	error = householder_blocked_float(matrix_float, NULL, tau_float, order,
+		MAX(block_size, 1));
+	if(error == 2) {
+		goto free_all;
+	}
+
+	// X_0 by the single precision factors, then X += A^{-1} (B - A X) with
+	// the residual in double precision until it stops halving. It has
+	// converged if it stopped at the rounding level
+	// |R|_F <= sqrt(n) eps |A|_F |X|_F
+	if(!error) {
+		for(size_t i = 0; i < size; i++) {
+			correction[i] = (float)rhs[i];
+		}
+		solve_systems_float(matrix_float, tau_float, correction, order,
+			amount);
+		for(size_t i = 0; i < size; i++) {
+			rhs[i] = correction[i];
+		}
+
+		for(int steps = 0; steps <= REFINEMENT_ITERATIONS; steps++) {
+			// R = B - A X column by column of A, a column serves a whole
+			// chunk of right-hand sides while it is in cache
+			memcpy(residual, copy, size * sizeof(double));
+			for(int c = 0; c < amount; c += chunk) {
+				chunk = MIN(BLOCK_COLUMNS, amount - c);
+				for(int k = 0; k < order; k++) {
+					for(int j = c; j < c + chunk; j++) {
+						vector_axpy(-rhs[COORD(j, k, order)], matrix +
+							COORD(k, 0, order), residual + COORD(j, 0, order),
+							order);
+					}
+				}
+			}
+			norm = 0.0;
+			solution_norm = 0.0;
+			for(size_t i = 0; i < size; i++) {
+				norm += SQUARE(residual[i]);
+				solution_norm += SQUARE(rhs[i]);
+			}
+			norm = sqrt(norm);
+
+			// Steps are cheap, so they go on while the residual halves
+			if(norm == 0.0 || norm > 0.5 * previous_norm) {
+				if(norm <= sqrt((double)order) * DBL_EPSILON * matrix_norm *
+					sqrt(solution_norm)) {
+					*iterations = steps;
+				}
+				break;
+			}
+			previous_norm = norm;
+
+			for(size_t i = 0; i < size; i++) {
+				correction[i] = (float)residual[i];
+			}
+			solve_systems_float(matrix_float, tau_float, correction, order,
+				amount);
+			for(size_t i = 0; i < size; i++) {
+				rhs[i] += correction[i];
+			}
+		}
+	}
+
+	// Single precision factorization broke down or the refinement did not
+	// converge: solve in double precision
+	if(*iterations < 0) {
+		factors = (double*)malloc((size_t)order * order * sizeof(double));
+		tau = (double*)malloc(order * sizeof(double));
+		if(!factors || !tau) {
+			error = 2;
+		} else {
+			memcpy(factors, matrix, (size_t)order * order * sizeof(double));
+			memcpy(rhs, copy, size * sizeof(double));
+			error = factorize_matrix(factors, tau, order, block_size);
+			if(!error) {
+				solve_systems(factors, tau, rhs, order, amount);
+			}
+		}
+		free(factors);
+		free(tau);
 	}
 
+	free_all:
+	free(matrix_float);
+	free(tau_float);
+	free(correction);
+	free(copy);
+	free(residual);
+
+	return error;
+}
+
+// Factorizes matrix = QR by panels of block_size columns. R is stored in
+// the upper triangle, the reflectors H_i = I - tau_i v_i v_i^T are stored
+// below the diagonal with the implicit unit head. If result is not NULL,
+// Q^T is applied to it as well
+static int householder_blocked(double *matrix, double *result, double *tau,
+		int order, int block_size) {
+	double s, norm1, head;
+	double *t, *w, *x, *v, *vt, *diag;
+	int block, li, error = 0;
+
+	t = (double*)malloc((size_t)block_size * block_size * sizeof(double));
+	w = (double*)malloc((size_t)block_size * UPDATE_COLUMNS * sizeof(double));
+	x = (double*)malloc((size_t)order * UPDATE_COLUMNS * sizeof(double));
+	v = (double*)malloc((size_t)block_size * order * sizeof(double));
+	vt = (double*)malloc((size_t)block_size * order * sizeof(double));
+	diag = (double*)malloc((size_t)block_size * sizeof(double));
+	if(!t || !w || !x || !v || !vt || !diag) {
+		error = 2;
+		goto free_all;
+	}
+
+	for(int p = 0; p < order; p += block) {
+		block = MIN(block_size, order - p);
+
+		// Panel factorization: build reflectors p, ..., p + block - 1 and
+		// apply them only to the columns of the panel itself
+		for(int i = p; i < p + block; i++) {
+			li = i - p;
+
+			s = vector_dot(matrix + COORD(i, i + 1, order),
+				matrix + COORD(i, i + 1, order), order - i - 1);
+
+			norm1 = sqrt(SQUARE(matrix[COORD(i, i, order)]) + s);
+
+			if(norm1 < EPS) {
+				error = 1; // non-invertible matrix
+				goto free_all;
+			}
+
+			if(s < EPS) {
+				// Identity reflector: zero tau kills both the i-th row and
+				// the i-th column of T
+				tau[i] = 0.0;
+				diag[li] = matrix[COORD(i, i, order)];
+				matrix[COORD(i, i, order)] = 1.0;
+				for(int r = 0; r <= li; r++) {
+					t[COORD(li, r, block_size)] = 0.0;
+				}
+				continue;
+			}
+
+			// Reflect onto -sign(a_ii) * norm1 so that the head of v never
+			// suffers from cancellation, then scale v to the unit head
+			diag[li] = matrix[COORD(i, i, order)] > 0 ? -norm1 : norm1;
+			head = matrix[COORD(i, i, order)] - diag[li];
+			tau[i] = 2.0 / (1.0 + s / (head * head));
+			matrix[COORD(i, i, order)] = 1.0;
+			head = 1.0 / head;
+			for(int k = i + 1; k < order; k++) {
+				matrix[COORD(i, k, order)] *= head;
+			}
+
+			for(int j = i + 1; j < p + block; j++) {
+				vector_reflect(tau[i], matrix + COORD(i, i, order),
+					matrix + COORD(j, i, order), order - i);
+			}
+
+			// Extend T so that H_p ... H_i = I - V T V^T:
+			// T[0..li-1, li] = -tau * T[0..li-1, 0..li-1] * V^T v_i
+			for(int r = 0; r < li; r++) {
+				w[r] = vector_dot(matrix + COORD(p + r, i, order),
+					matrix + COORD(i, i, order), order - i);
+			}
+			for(int r = 0; r < li; r++) {
+				s = 0.0;
+				for(int q = r; q < li; q++) {
+					s += t[COORD(q, r, block_size)] * w[q];
+				}
+				t[COORD(li, r, block_size)] = -tau[i] * s;
+			}
+			t[COORD(li, li, block_size)] = tau[i];
+		}
+
+		// Pack V and its transpose, then apply Q^T = I - V T^T V^T to the
+		// trailing matrix and to result
+		for(int r = 0; r < block; r++) {
+			memset(v + COORD(r, 0, order - p), 0, r * sizeof(double));
+			memcpy(v + COORD(r, r, order - p), matrix + COORD(p + r, p + r,
+				order), (order - p - r) * sizeof(double));
+		}
+		for(int k = 0; k < order - p; k++) {
+			for(int r = 0; r < block; r++) {
+				vt[COORD(k, r, block_size)] = v[COORD(r, k, order - p)];
+			}
+		}
+		error = apply_block_reflector(v, vt, matrix, order, p, block,
+			p + block, order, t, block_size, w, x);
+		if(!error && result) {
+			error = apply_block_reflector(v, vt, result, order, p, block, 0,
+				order, t, block_size, w, x);
+		}
+		if(error) {
+			goto free_all;
+		}
+
+		// Finalize: set the diagonal of the panel
+		for(int i = p; i < p + block; i++) {
+			matrix[COORD(i, i, order)] = diag[i - p];
+		}
+	}
+
+	free_all:
+	free(t);
+	free(w);
+	free(x);
+	free(v);
+	free(vt);
+	free(diag);
+
+	return error;
+}
+
+// Refines X = result by the Newton-Schulz steps X += X (I - A X) computed
+// column panel by column panel, previous holds the X of the last step.
+// The residual R = I - A X is squared every step, so it converges when the
+// spectral radius of the first R is below 1. Returns the number of steps
+// or -1 if the residual does not at least halve before it reaches the
+// rounding level |R|_F <= sqrt(n) eps |A|_F |X|_F
+static int refine_inverse(const double *matrix, double *result,
+		double *previous, int order, double *work) {
+	double matrix_norm = 0.0, norm, previous_norm = INFINITY, solution_norm;
+	double bound, *residual = work, *correction = work +
+		(size_t)order * RESIDUAL_COLUMNS;
+	int width;
+
+	for(size_t i = 0; i < (size_t)order * order; i++) {
+		matrix_norm += SQUARE(matrix[i]);
+	}
+	matrix_norm = sqrt(matrix_norm);
+
+	for(int steps = 1; steps <= REFINEMENT_ITERATIONS; steps++) {
+		memcpy(previous, result, (size_t)order * order * sizeof(double));
+		norm = 0.0;
+		solution_norm = 0.0;
+
+		for(int j = 0; j < order; j += width) {
+			width = MIN(RESIDUAL_COLUMNS, order - j);
+
+			// R = I - A X for the columns j, ..., j + width - 1
+			if(multiply_matrices(matrix, order, previous + COORD(j, 0, order),
+				order, residual, order, order, width, order, 0, 1)) {
+				return -1;
+			}
+			for(int jj = 0; jj < width; jj++) {
+				for(int i = 0; i < order; i++) {
+					residual[COORD(jj, i, order)] = (double)(i == j + jj) -
+						residual[COORD(jj, i, order)];
+					norm += SQUARE(residual[COORD(jj, i, order)]);
+					solution_norm += SQUARE(previous[COORD(j + jj, i, order)]);
+				}
+			}
+
+			if(multiply_matrices(previous, order, residual, order, correction,
+				order, order, width, order, 0, 1)) {
+				return -1;
+			}
+			for(int jj = 0; jj < width; jj++) {
+				vector_axpy(1.0, correction + COORD(jj, 0, order),
+					result + COORD(j + jj, 0, order), order);
+			}
+		}
+		norm = sqrt(norm);
+		bound = sqrt((double)order) * DBL_EPSILON * matrix_norm *
+			sqrt(solution_norm);
+
+		// The new residual is about the square of the computed one
+		if(norm * norm <= bound) {
+			return steps;
+		}
+		if(norm > 0.5 * previous_norm) {
+			return norm <= bound ? steps : -1;
+		}
+		previous_norm = norm;
+	}
+
+	return -1;
+}
+
+// Single precision copy of invert_matrix_blocked()
+static int invert_matrix_float(float *matrix, float *result, int order,
+		int block_size) {
+	float *tau;
+	int error;
+
+	tau = (float*)malloc(order * sizeof(float));
+	if(!tau) {
+		return 2;
+	}
+
+	memset(result, 0, (size_t)order * order * sizeof(float));
+	for(int i = 0; i < order; i++)
+		result[COORD(i, i, order)] = 1.0f;
+
+	error = householder_blocked_float(matrix, result, tau, order,
+		MAX(block_size, 1));
+	free(tau);
+	if(error) {
+		return error;
+	}
+
+	return back_substitution_blocked_float(matrix, result, order,
+		MAX(block_size, 1));
+}
+
+// Single precision copy of householder_blocked()
+static int householder_blocked_float(float *matrix, float *result,
+		float *tau, int order, int block_size) {
+	float s, norm1, head;
+	float *t, *w, *x, *v, *vt, *diag;
+	int block, li, error = 0;
+
+	t = (float*)malloc((size_t)block_size * block_size * sizeof(float));
+	w = (float*)malloc((size_t)block_size * UPDATE_COLUMNS * sizeof(float));
+	x = (float*)malloc((size_t)order * UPDATE_COLUMNS * sizeof(float));
+	v = (float*)malloc((size_t)block_size * order * sizeof(float));
+	vt = (float*)malloc((size_t)block_size * order * sizeof(float));
+	diag = (float*)malloc((size_t)block_size * sizeof(float));
+	if(!t || !w || !x || !v || !vt || !diag) {
+		error = 2;
+		goto free_all;
+	}
+
+	for(int p = 0; p < order; p += block) {
+		block = MIN(block_size, order - p);
+
+		for(int i = p; i < p + block; i++) {
+			li = i - p;
+
+			s = vector_dot_float(matrix + COORD(i, i + 1, order),
+				matrix + COORD(i, i + 1, order), order - i - 1);
+
+			norm1 = sqrtf(SQUARE(matrix[COORD(i, i, order)]) + s);
+
+			if(norm1 < FLT_EPSILON * FLT_EPSILON) {
+				error = 1; // non-invertible matrix
+				goto free_all;
+			}
+
+			if(s < FLT_EPSILON * FLT_EPSILON) {
+				tau[i] = 0.0f;
+				diag[li] = matrix[COORD(i, i, order)];
+				matrix[COORD(i, i, order)] = 1.0f;
+				for(int r = 0; r <= li; r++) {
+					t[COORD(li, r, block_size)] = 0.0f;
+				}
+				continue;
+			}
+
+			diag[li] = matrix[COORD(i, i, order)] > 0.0f ? -norm1 : norm1;
+			head = matrix[COORD(i, i, order)] - diag[li];
+			tau[i] = 2.0f / (1.0f + s / (head * head));
+			matrix[COORD(i, i, order)] = 1.0f;
+			head = 1.0f / head;
+			for(int k = i + 1; k < order; k++) {
+				matrix[COORD(i, k, order)] *= head;
+			}
+
+			for(int j = i + 1; j < p + block; j++) {
+				vector_reflect_float(tau[i], matrix + COORD(i, i, order),
+					matrix + COORD(j, i, order), order - i);
+			}
+
+			for(int r = 0; r < li; r++) {
+				w[r] = vector_dot_float(matrix + COORD(p + r, i, order),
+					matrix + COORD(i, i, order), order - i);
+			}
+			for(int r = 0; r < li; r++) {
+				s = 0.0f;
+				for(int q = r; q < li; q++) {
+					s += t[COORD(q, r, block_size)] * w[q];
+				}
+				t[COORD(li, r, block_size)] = -tau[i] * s;
+			}
+			t[COORD(li, li, block_size)] = tau[i];
+		}
+
+		for(int r = 0; r < block; r++) {
+			memset(v + COORD(r, 0, order - p), 0, r * sizeof(float));
+			memcpy(v + COORD(r, r, order - p), matrix + COORD(p + r, p + r,
+				order), (order - p - r) * sizeof(float));
+		}
+		for(int k = 0; k < order - p; k++) {
+			for(int r = 0; r < block; r++) {
+				vt[COORD(k, r, block_size)] = v[COORD(r, k, order - p)];
+			}
+		}
+		error = apply_block_reflector_float(v, vt, matrix, order, p, block,
+			p + block, order, t, block_size, w, x);
+		if(!error && result) {
+			error = apply_block_reflector_float(v, vt, result, order, p,
+				block, 0, order, t, block_size, w, x);
+		}
+		if(error) {
+			goto free_all;
+		}
+
+		for(int i = p; i < p + block; i++) {
+			matrix[COORD(i, i, order)] = diag[i - p];
+		}
+	}
+
+	free_all:
+	free(t);
+	free(w);
+	free(x);
+	free(v);
+	free(vt);
+	free(diag);
+
+	return error;
+}
+
+// Single precision copy of apply_block_reflector()
+static int apply_block_reflector_float(const float *v, const float *vt,
+		float *target, int order, int first, int block, int columns_start,
+		int columns_end, const float *t, int block_size, float *w,
+		float *x) {
+	float s;
+	int chunk, length = order - first;
+
+	for(int c = columns_start; c < columns_end; c += chunk) {
+		chunk = MIN(UPDATE_COLUMNS, columns_end - c);
+
+		if(multiply_matrices_float(vt, block_size, target + COORD(c, first,
+			order), order, w, block_size, block, chunk, length, 0, 1)) {
+			return 2;
+		}
+
+		for(int j = 0; j < chunk; j++) {
+			for(int r = block - 1; r >= 0; r--) {
+				s = 0.0f;
+				for(int q = 0; q <= r; q++) {
+					s += t[COORD(r, q, block_size)] *
+						w[COORD(j, q, block_size)];
+				}
+				w[COORD(j, r, block_size)] = s;
+			}
+		}
+
+		if(multiply_matrices_float(v, length, w, block_size, x, length,
+			length, chunk, block, 0, 1)) {
+			return 2;
+		}
+		for(int j = 0; j < chunk; j++) {
+			vector_axpy_float(-1.0f, x + COORD(j, 0, length), target +
+				COORD(c + j, first, order), length);
+		}
+	}
+
+	return 0;
+}
+
+// Single precision copy of back_substitution_blocked()
+static int back_substitution_blocked_float(const float *matrix,
+		float *result, int order, int block_size) {
+	float s, *x;
+	int first, chunk;
+
+	x = (float*)malloc((size_t)order * UPDATE_COLUMNS * sizeof(float));
+	if(!x) {
+		return 2;
+	}
+
+	for(int last = order; last > 0; last = first) {
+		first = MAX(0, last - block_size);
+
+		for(int i = last - 1; i >= first; i--) {
+			s = matrix[COORD(i, i, order)];
+			for(int j = 0; j < order; j++) {
+				result[COORD(j, i, order)] /= s;
+			}
+			for(int j = 0; j < order; j++) {
+				vector_axpy_float(-result[COORD(j, i, order)], matrix +
+					COORD(i, first, order), result + COORD(j, first, order),
+					i - first);
+			}
+		}
+
+		for(int c = 0; c < order && first > 0; c += chunk) {
+			chunk = MIN(UPDATE_COLUMNS, order - c);
+			if(multiply_matrices_float(matrix + COORD(first, 0, order),
+				order, result + COORD(c, first, order), order, x, first,
+				first, chunk, last - first, 0, 1)) {
+				free(x);
+				return 2;
+			}
+			for(int j = 0; j < chunk; j++) {
+				vector_axpy_float(-1.0f, x + COORD(j, 0, first), result +
+					COORD(c + j, 0, order), first);
+			}
+		}
+	}
+
+	free(x);
+
+	return 0;
+}
+
+// Single precision copy of solve_systems()
+static void solve_systems_float(const float *matrix, const float *tau,
+		float *rhs, int order, int amount) {
+	float s;
+	float *x;
+	int chunk;
+
+	for(int c = 0; c < amount; c += chunk) {
+		chunk = MIN(BLOCK_COLUMNS, amount - c);
+
+		for(int i = 0; i < order; i++) {
+			if(tau[i] == 0.0f) {
+				continue;
+			}
+			for(int j = c; j < c + chunk; j++) {
+				x = rhs + COORD(j, 0, order);
+				s = tau[i] * (x[i] + vector_dot_float(matrix + COORD(i, i + 1,
+					order), x + i + 1, order - i - 1));
+				x[i] -= s;
+				vector_axpy_float(-s, matrix + COORD(i, i + 1, order),
+					x + i + 1, order - i - 1);
+			}
+		}
+
+		for(int i = order - 1; i >= 0; i--) {
+			for(int j = c; j < c + chunk; j++) {
+				x = rhs + COORD(j, 0, order);
+				x[i] /= matrix[COORD(i, i, order)];
+				vector_axpy_float(-x[i], matrix + COORD(i, 0, order), x, i);
+			}
+		}
+	}
+}
+
+// Applies Q^T = I - V T^T V^T of the panel starting at the row first to
+// the columns columns_start, ..., columns_end - 1 of target. V is packed by
+// columns with the leading dimension order - first and explicit zeros above
+// the unit part, vt holds V^T with the leading dimension block_size, as
+// does T. Columns are processed in chunks: W = V^T C and X = V (T^T W) are
+// packed matrix products, then C -= X. x holds the chunk of X. Returns 2 if
+// there is not enough memory for the products
+static int apply_block_reflector(const double *v, const double *vt,
+		double *target, int order, int first, int block, int columns_start,
+		int columns_end, const double *t, int block_size, double *w,
+		double *x) {
+	double s;
+	int chunk, length = order - first;
+
+	for(int c = columns_start; c < columns_end; c += chunk) {
+		chunk = MIN(UPDATE_COLUMNS, columns_end - c);
+
+		if(multiply_matrices(vt, block_size, target + COORD(c, first, order),
+			order, w, block_size, block, chunk, length, 0, 1)) {
+			return 2;
+		}
+
+		// W = T^T W, T is upper triangular and only block x block
+		for(int j = 0; j < chunk; j++) {
+			for(int r = block - 1; r >= 0; r--) {
+				s = 0.0;
+				for(int q = 0; q <= r; q++) {
+					s += t[COORD(r, q, block_size)] *
+						w[COORD(j, q, block_size)];
+				}
+				w[COORD(j, r, block_size)] = s;
+			}
+		}
+
+		if(multiply_matrices(v, length, w, block_size, x, length, length,
+			chunk, block, 0, 1)) {
+			return 2;
+		}
+		for(int j = 0; j < chunk; j++) {
+			vector_axpy(-1.0, x + COORD(j, 0, length), target + COORD(c + j,
+				first, order), length);
+		}
+	}
+
+	return 0;
+}
+
+static void back_substitution(double *matrix, double *result, int order) {
+	double s;
+
 	// Back substitution of Gaussian method
 	// We know that the matrix is inversible at the moment
 	// Note: no action is required on matrix
@@ -97,21 +1033,96 @@ int invert_matrix(double *matrix, double *result, int order) {
 		// j-th row of result for j = 0, ..., i - 1
 		// But do it in the column-first order
 		for(int j = 0; j < order; j++) {
-			tmp = result[COORD(j, i, order)];
-			for(int k = 0; k < i; k++) {
-				result[COORD(j, k, order)] -= tmp * matrix[COORD(i, k, order)];
+			vector_axpy(-result[COORD(j, i, order)], matrix + COORD(i, 0,
+				order), result + COORD(j, 0, order), i);
+		}
+	}
+}
+
+// back_substitution() by row blocks of R from the bottom: the rows of a
+// block are solved one by one within the block, then the rows above it
+// are updated by the packed product with the block column of R. Returns 2
+// if there is not enough memory
+static int back_substitution_blocked(const double *matrix, double *result,
+		int order, int block_size) {
+	double s, *x;
+	int first, chunk;
+
+	x = (double*)malloc((size_t)order * UPDATE_COLUMNS * sizeof(double));
+	if(!x) {
+		return 2;
+	}
+
+	for(int last = order; last > 0; last = first) {
+		first = MAX(0, last - block_size);
+
+		for(int i = last - 1; i >= first; i--) {
+			s = matrix[COORD(i, i, order)];
+			for(int j = 0; j < order; j++) {
+				result[COORD(j, i, order)] /= s;
+			}
+			for(int j = 0; j < order; j++) {
+				vector_axpy(-result[COORD(j, i, order)], matrix + COORD(i,
+					first, order), result + COORD(j, first, order),
+					i - first);
+			}
+		}
+
+		// Rows 0, ..., first - 1 of result -= R[0..first-1, first..last-1]
+		// times rows first, ..., last - 1 of result
+		for(int c = 0; c < order && first > 0; c += chunk) {
+			chunk = MIN(UPDATE_COLUMNS, order - c);
+			if(multiply_matrices(matrix + COORD(first, 0, order), order,
+				result + COORD(c, first, order), order, x, first, first,
+				chunk, last - first, 0, 1)) {
+				free(x);
+				return 2;
+			}
+			for(int j = 0; j < chunk; j++) {
+				vector_axpy(-1.0, x + COORD(j, 0, first), result + COORD(c + j,
+					0, order), first);
 			}
 		}
 	}
 
-	// And... here we go
+	free(x);
+
 	return 0;
 }
 
 double discrepancy(double *matrix, double *result, int order) {
 	double product_elem = 0.0;
 	double norm_square = 0.0;
+	double *product;
+	int width;
+
+	// A * A^{-1} is formed by panels of columns with the packed
+	// multiplication, only the current panel is kept in memory
+	product = (double*)malloc((size_t)order * RESIDUAL_COLUMNS *
+		sizeof(double));
+	if(product) {
+		for(int j = 0; j < order; j += width) {
+			width = MIN(RESIDUAL_COLUMNS, order - j);
+			if(multiply_matrices(matrix, order, result + COORD(j, 0, order),
+				order, product, order, order, width, order, 0, 1)) {
+				norm_square = 0.0;
+				break;
+			}
+			for(int jj = 0; jj < width; jj++) {
+				product[COORD(jj, j + jj, order)] -= 1.0;
+				for(int i = 0; i < order; i++) {
+					norm_square += SQUARE(product[COORD(jj, i, order)]);
+				}
+			}
+			if(j + width == order) {
+				free(product);
+				return sqrt(norm_square);
+			}
+		}
+		free(product);
+	}
 
+	// Not enough memory for the packed multiplication
 	for(int i = 0; i < order; i++) {
 		for(int j = 0; j < order; j++) {
 			product_elem = 0.0;
@@ -126,3 +1137,96 @@ double discrepancy(double *matrix, double *result, int order) {
 
 	return sqrt(norm_square);
 }
+
+double gaussian(unsigned long long *state) {
+	double u1, u2;
+	unsigned long long x;
+
+	x = (*state += 0x9e3779b97f4a7c15ULL);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	u1 = ((double)((x ^ (x >> 31)) >> 11) + 0.5) / 9007199254740992.0;
+
+	x = (*state += 0x9e3779b97f4a7c15ULL);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	u2 = ((double)((x ^ (x >> 31)) >> 11) + 0.5) / 9007199254740992.0;
+
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+double estimate_discrepancy(double *matrix, double *result, int order,
+		int probes) {
+	double norm_square = 0.0;
+	double *g, *y;
+	unsigned long long state;
+
+	g = (double*)malloc(2 * (size_t)order * sizeof(double));
+	if(!g) {
+		return -1.0;
+	}
+	y = g + order;
+
+	// E |(A X - I) g|^2 = |A X - I|_F^2 for g ~ N(0, I), every probe costs
+	// two matrix-vector products by columns
+	for(int p = 0; p < probes; p++) {
+		state = (unsigned long long)p;
+		for(int i = 0; i < order; i++) {
+			g[i] = gaussian(&state);
+			y[i] = 0.0;
+		}
+
+		for(int k = 0; k < order; k++) {
+			vector_axpy(g[k], result + COORD(k, 0, order), y, order);
+		}
+		for(int k = 0; k < order; k++) {
+			vector_axpy(-y[k], matrix + COORD(k, 0, order), g, order);
+		}
+
+		norm_square += vector_dot(g, g, order);
+	}
+
+	free(g);
+
+	return sqrt(norm_square / probes);
+}
+
+void discrepancy_bounds(double estimate, int probes, double *lower,
+		double *upper) {
+	// Laurent-Massart tail bounds for the sum of probes * order weighted
+	// chi-square variables: each side fails with probability at most
+	// 2.5% whatever the singular values of A X - I are
+	double x = log(40.0) / probes;
+
+	*lower = estimate / sqrt(1.0 + 2.0 * sqrt(x) + 2.0 * x);
+	*upper = 2.0 * sqrt(x) < 1.0 ? estimate / sqrt(1.0 - 2.0 * sqrt(x)) :
+		INFINITY;
+}
+
+double solution_discrepancy(double *matrix, double *solutions, double *rhs,
+		int order, int amount) {
+	double norm_square = 0.0, rhs_norm_square = 0.0;
+	double *x, *b;
+
+	// Accumulate A x - b in b column by column of A
+	for(int j = 0; j < amount; j++) {
+		x = solutions + COORD(j, 0, order);
+		b = rhs + COORD(j, 0, order);
+		for(int i = 0; i < order; i++) {
+			rhs_norm_square += SQUARE(b[i]);
+		}
+		for(int k = 0; k < order; k++) {
+			for(int i = 0; i < order; i++) {
+				b[i] -= matrix[COORD(k, i, order)] * x[k];
+			}
+		}
+		for(int i = 0; i < order; i++) {
+			norm_square += SQUARE(b[i]);
+		}
+	}
+
+	if(rhs_norm_square == 0.0) {
+		return sqrt(norm_square);
+	}
+	return sqrt(norm_square / rhs_norm_square);
+}
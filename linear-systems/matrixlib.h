@@ -18,4 +18,46 @@
 
 int invert_matrix(double *matrix, double *result, int order);
 
-double discrepancy(double *matrix, double *result, int order);
\ No newline at end of file
+int invert_matrix_blocked(double *matrix, double *result, int order,
+	int block_size);
+
+// Inverts in single precision and refines the result in double precision
+// against the intact matrix. iterations is set to the number of refinement
+// steps or to -1 if it fell back to invert_matrix_blocked()
+int invert_matrix_mixed(double *matrix, double *result, int order,
+	int block_size, int *iterations);
+
+// Inverts BATCH_LANES matrices interleaved element by element as in
+// kernels.h, so the reflector loops run across the matrices. failed is set
+// for the lanes with non-invertible matrices
+void invert_batch(double *batch, double *result, int order, int *failed);
+
+int factorize_matrix(double *matrix, double *tau, int order, int block_size);
+
+void solve_systems(const double *matrix, const double *tau, double *rhs,
+	int order, int amount);
+
+// Solves A X = B for the amount right-hand sides in rhs with the single
+// precision QR factors of the intact matrix, then refines X in double
+// precision by the residual correction, O(n^2) per right-hand side and
+// step. iterations is set to the number of refinement steps or to -1 if
+// it fell back to factorize_matrix() and solve_systems()
+int solve_systems_mixed(const double *matrix, double *rhs, int order,
+	int amount, int block_size, int *iterations);
+
+double discrepancy(double *matrix, double *result, int order);
+
+// Estimate of |A A^{-1} - I|_F by probes Gaussian vectors in O(n^2) per
+// probe, returns -1 if there is not enough memory
+double estimate_discrepancy(double *matrix, double *result, int order,
+	int probes);
+
+// Gaussian sample by Box-Muller from the splitmix64 sequence in state
+double gaussian(unsigned long long *state);
+
+// 95% confidence interval of the true value given the estimate
+void discrepancy_bounds(double estimate, int probes, double *lower,
+	double *upper);
+
+double solution_discrepancy(double *matrix, double *solutions, double *rhs,
+	int order, int amount);
\ No newline at end of file
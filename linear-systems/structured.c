@@ -0,0 +1,253 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "kernels.h"
+#include "matrixio.h"
+#include "matrixlib.h"
+#include "structured.h"
+
+static double structured_element(const double *diagonals, double corner,
+		int order, int i, int j);
+
+static void structured_multiply(const double *diagonals, double corner,
+		const double *x, double *y, int order);
+
+int formula_structured(int formula_number) {
+	return formula_number >= 1 && formula_number <= 3;
+}
+
+int invert_formula(double *diagonals, double *corner, int order,
+		int formula_number) {
+	double *diagonal = diagonals, *off_diagonal = diagonals + order;
+
+	*corner = 0.0;
+	if(order == 1) {
+		if(f(1, formula_number, 1, 1) == 0.0) {
+			return 1; // non-invertible matrix
+		}
+		diagonal[0] = 1.0 / f(1, formula_number, 1, 1);
+		return 0;
+	}
+
+	switch(formula_number) {
+		case 1:
+			// A(i, j) = min(n + 1 - i, n + 1 - j) is the reversed
+			// min(i, j) matrix, whose inverse is the second difference
+			// with 1 in the last diagonal element
+			for(int i = 0; i < order; i++) {
+				diagonal[i] = 2.0;
+				off_diagonal[i] = -1.0;
+			}
+			diagonal[0] = 1.0;
+			break;
+		case 2:
+			// A(i, j) = max(i, j)
+			for(int i = 0; i < order; i++) {
+				diagonal[i] = -2.0;
+				off_diagonal[i] = 1.0;
+			}
+			diagonal[0] = -1.0;
+			diagonal[order - 1] = -(double)(order - 1) / order;
+			break;
+		case 3:
+			// Distance matrix of the path: A^{-1} = -L / 2 +
+			// (e_1 + e_n)(e_1 + e_n)^T / (2 (n - 1)), L is its Laplacian
+			for(int i = 0; i < order; i++) {
+				diagonal[i] = -1.0;
+				off_diagonal[i] = 0.5;
+			}
+			diagonal[0] = -0.5;
+			diagonal[order - 1] = -0.5;
+			*corner = 0.5 / (order - 1);
+			break;
+		default:
+			return 1;
+	}
+	off_diagonal[order - 1] = 0.0;
+
+	return 0;
+}
+
+void formula_multiply(const double *x, double *y, int order,
+		int formula_number) {
+	double sum = 0.0, weighted_sum = 0.0, total = 0.0, weighted_total = 0.0;
+
+	switch(formula_number) {
+		case 1:
+		case 2:
+			// A(i, j) = g(max(i, j)), so
+			// y_i = g(i) sum_{l <= i} x_l + sum_{l > i} g(l) x_l
+			for(int i = order - 1; i >= 0; i--) {
+				y[i] = weighted_sum;
+				weighted_sum += f(order, formula_number, i + 1, i + 1) * x[i];
+			}
+			for(int i = 0; i < order; i++) {
+				sum += x[i];
+				y[i] += f(order, formula_number, i + 1, i + 1) * sum;
+			}
+			break;
+		case 3:
+			// y_i = sum_{l < i} (i - l) x_l + sum_{l > i} (l - i) x_l
+			for(int i = 0; i < order; i++) {
+				total += x[i];
+				weighted_total += (i + 1) * x[i];
+			}
+			for(int i = 0; i < order; i++) {
+				sum += x[i];
+				weighted_sum += (i + 1) * x[i];
+				y[i] = (i + 1) * (2.0 * sum - total) - 2.0 * weighted_sum +
+					weighted_total;
+			}
+			break;
+		default:
+			for(int i = 0; i < order; i++) {
+				y[i] = 0.0;
+				for(int j = 0; j < order; j++) {
+					y[i] += f(order, formula_number, i + 1, j + 1) * x[j];
+				}
+			}
+	}
+}
+
+void print_structured(const double *diagonals, double corner, int order,
+		int max_cols_rows) {
+	int size = MIN(order, max_cols_rows);
+	double *block = (double*)malloc((size_t)size * size * sizeof(double));
+
+	if(!block) {
+		return;
+	}
+	for(int i = 0; i < size; i++) {
+		for(int j = 0; j < size; j++) {
+			block[COORD(j, i, size)] = structured_element(diagonals, corner,
+				order, i, j);
+		}
+	}
+	print_matrix(block, size, size, size);
+	free(block);
+}
+
+double structured_discrepancy(const double *diagonals, double corner,
+		int order, int formula_number) {
+	double norm_square = 0.0;
+	double *x, *y;
+
+	x = (double*)calloc(2 * (size_t)order, sizeof(double));
+	if(!x) {
+		return -1.0;
+	}
+	y = x + order;
+
+	// Column j of A^{-1} has at most five nonzero elements, A times it
+	// costs O(n) by formula_multiply()
+	for(int j = 0; j < order; j++) {
+		for(int i = MAX(j - 1, 0); i <= MIN(j + 1, order - 1); i++) {
+			x[i] = structured_element(diagonals, corner, order, i, j);
+		}
+		x[0] = structured_element(diagonals, corner, order, 0, j);
+		x[order - 1] = structured_element(diagonals, corner, order,
+			order - 1, j);
+
+		formula_multiply(x, y, order, formula_number);
+		y[j] -= 1.0;
+		norm_square += vector_dot(y, y, order);
+
+		for(int i = MAX(j - 1, 0); i <= MIN(j + 1, order - 1); i++) {
+			x[i] = 0.0;
+		}
+		x[0] = 0.0;
+		x[order - 1] = 0.0;
+	}
+
+	free(x);
+
+	return sqrt(norm_square);
+}
+
+double estimate_structured_discrepancy(const double *diagonals,
+		double corner, int order, int formula_number, int probes) {
+	double norm_square = 0.0;
+	double *g, *y, *z;
+	unsigned long long state;
+
+	g = (double*)malloc(3 * (size_t)order * sizeof(double));
+	if(!g) {
+		return -1.0;
+	}
+	y = g + order;
+	z = y + order;
+
+	for(int p = 0; p < probes; p++) {
+		state = (unsigned long long)p;
+		for(int i = 0; i < order; i++) {
+			g[i] = gaussian(&state);
+		}
+
+		structured_multiply(diagonals, corner, g, y, order);
+		formula_multiply(y, z, order, formula_number);
+		vector_axpy(-1.0, g, z, order);
+
+		norm_square += vector_dot(z, z, order);
+	}
+
+	free(g);
+
+	return sqrt(norm_square / probes);
+}
+
+static double structured_element(const double *diagonals, double corner,
+		int order, int i, int j) {
+	double element = 0.0;
+
+	if(i == j) {
+		element = diagonals[i];
+	} else if(ABS(i - j) == 1) {
+		element = diagonals[order + MIN(i, j)];
+	}
+	if((i == 0 || i == order - 1) && (j == 0 || j == order - 1)) {
+		element += corner;
+	}
+
+	return element;
+}
+
+// y = A^{-1} x for the structured inverse
+static void structured_multiply(const double *diagonals, double corner,
+		const double *x, double *y, int order) {
+	const double *off_diagonal = diagonals + order;
+	double t;
+
+	for(int i = 0; i < order; i++) {
+		y[i] = diagonals[i] * x[i];
+		if(i > 0) {
+			y[i] += off_diagonal[i - 1] * x[i - 1];
+		}
+		if(i + 1 < order) {
+			y[i] += off_diagonal[i] * x[i + 1];
+		}
+	}
+	if(order > 1) {
+		t = corner * (x[0] + x[order - 1]);
+		y[0] += t;
+		y[order - 1] += t;
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ *  Copyright 2020 Peter Shkenev
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+// Fast paths for the matrices with a known structure. The inverse of the
+// formula matrices k = 1, 2, 3 is kept as the symmetric tridiagonal matrix
+// plus corner * (e_1 + e_n)(e_1 + e_n)^T: diagonals hold its main diagonal
+// in [0, order) and the off diagonal in [order, 2 * order - 1)
+
+// Whether the formula matrix has such an inverse
+int formula_structured(int formula_number);
+
+int invert_formula(double *diagonals, double *corner, int order,
+	int formula_number);
+
+// y = A x for the formula matrix in O(n) by prefix sums
+void formula_multiply(const double *x, double *y, int order,
+	int formula_number);
+
+void print_structured(const double *diagonals, double corner, int order,
+	int max_cols_rows);
+
+// |A A^{-1} - I|_F in O(n^2) time and O(n) memory
+double structured_discrepancy(const double *diagonals, double corner,
+	int order, int formula_number);
+
+// Same estimate as estimate_discrepancy() in O(n) per probe
+double estimate_structured_discrepancy(const double *diagonals,
+	double corner, int order, int formula_number, int probes);